@@ -0,0 +1,49 @@
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "harness.h"
+
+#include "../lib/models/bounds.h"
+
+/**
+ * Time classifying bounding volumes scattered around a camera against its frustum, as culling does for every node
+ * subtree (boxes) and mesh (spheres).
+ */
+template <typename Volume>
+void BenchmarkFrustumTest(BenchmarkRunner &runner, const std::string &name, const std::vector<Volume> &volumes) {
+    Frustum frustum;
+    frustum.Set(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    runner.Run(name, double(volumes.size()), [&]() {
+        size_t n_visible = 0;
+        for (const auto &volume : volumes) {
+            n_visible += frustum.Test(volume) != FRUSTUM_OUTSIDE;
+        }
+        DoNotOptimize(n_visible);
+    });
+}
+
+int main(int argc, char **argv) {
+    BenchmarkRunner runner(argc, argv);
+
+    for (auto n_volumes : {1024u, 65536u}) {
+        std::mt19937 random(0);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.1f, 10.0f);
+
+        std::vector<BoundingBox> boxes(n_volumes);
+        std::vector<BoundingSphere> spheres(n_volumes);
+        for (unsigned int i = 0; i < n_volumes; ++i) {
+            auto min = glm::vec3(position(random), position(random), position(random));
+            boxes[i].Add(min);
+            boxes[i].Add(min + glm::vec3(size(random), size(random), size(random)));
+            spheres[i] = BoundingSphere{.center = boxes[i].GetCenter(), .radius = glm::length(boxes[i].GetExtents())};
+        }
+
+        BenchmarkFrustumTest(runner, "frustum_test/boxes:" + std::to_string(n_volumes), boxes);
+        BenchmarkFrustumTest(runner, "frustum_test/spheres:" + std::to_string(n_volumes), spheres);
+    }
+
+    return runner.Finish();
+}
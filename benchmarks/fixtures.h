@@ -0,0 +1,108 @@
+#ifndef BENCHMARKS_FIXTURES_H_
+#define BENCHMARKS_FIXTURES_H_
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include <assimp/scene.h>
+
+/**
+ * Synthetic triangle-soup aiMesh with positions, normals, uvs, tangents and bitangents.
+ */
+inline aiMesh *CreateMesh(unsigned int n_vertices, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    auto next = [&]() { return aiVector3D(distribution(random), distribution(random), distribution(random)); };
+
+    auto mesh = new aiMesh();
+    mesh->mNumVertices = n_vertices;
+    mesh->mVertices = new aiVector3D[n_vertices];
+    mesh->mNormals = new aiVector3D[n_vertices];
+    mesh->mTangents = new aiVector3D[n_vertices];
+    mesh->mBitangents = new aiVector3D[n_vertices];
+    mesh->mTextureCoords[0] = new aiVector3D[n_vertices];
+    for (unsigned int i = 0; i < n_vertices; ++i) {
+        mesh->mVertices[i] = next();
+        mesh->mNormals[i] = next();
+        mesh->mTangents[i] = next();
+        mesh->mBitangents[i] = next();
+        mesh->mTextureCoords[0][i] = next();
+    }
+
+    mesh->mNumFaces = n_vertices / 3;
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+        mesh->mFaces[i].mNumIndices = 3;
+        mesh->mFaces[i].mIndices = new unsigned int[3]{i * 3, i * 3 + 1, i * 3 + 2};
+    }
+
+    return mesh;
+}
+
+/**
+ * Connected side x side grid aiMesh on a sphere patch, with its triangles shuffled like an unoptimized export.
+ */
+inline aiMesh *CreateGridMesh(unsigned int side, unsigned int seed) {
+    auto mesh = new aiMesh();
+    mesh->mNumVertices = side * side;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    for (unsigned int y = 0; y < side; ++y) {
+        for (unsigned int x = 0; x < side; ++x) {
+            auto u = 6.2832f * float(x) / float(side), v = 3.1416f * float(y) / float(side);
+            auto position = aiVector3D(std::sin(v) * std::cos(u), std::sin(v) * std::sin(u), std::cos(v));
+            mesh->mVertices[y * side + x] = position;
+            mesh->mNormals[y * side + x] = position;
+        }
+    }
+
+    std::vector<unsigned int> quads((side - 1) * (side - 1));
+    for (unsigned int i = 0; i < quads.size(); ++i) {
+        quads[i] = i / (side - 1) * side + i % (side - 1);
+    }
+    std::shuffle(quads.begin(), quads.end(), std::mt19937(seed));
+
+    mesh->mNumFaces = unsigned(quads.size() * 2);
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for (unsigned int i = 0; i < quads.size(); ++i) {
+        auto a = quads[i], b = a + 1, c = a + side, d = c + 1;
+        mesh->mFaces[i * 2].mNumIndices = 3;
+        mesh->mFaces[i * 2].mIndices = new unsigned int[3]{a, c, b};
+        mesh->mFaces[i * 2 + 1].mNumIndices = 3;
+        mesh->mFaces[i * 2 + 1].mIndices = new unsigned int[3]{b, c, d};
+    }
+
+    return mesh;
+}
+
+/**
+ * Mesh-less aiNode hierarchy, every node offset by one unit along y from its parent.
+ *
+ * @param depth levels below this node
+ * @param fan_out children of every inner node, 1 for a chain
+ * @param name_prefix nodes are named name_prefix followed by their level
+ */
+inline aiNode *CreateNodeTree(unsigned int depth,
+                              unsigned int fan_out,
+                              const std::string &name_prefix,
+                              unsigned int level = 0) {
+    auto node = new aiNode();
+    node->mName.Set(name_prefix + std::to_string(level));
+    if (level > 0) {
+        node->mTransformation.b4 = 1.0f;
+    }
+
+    if (depth > 0) {
+        node->mNumChildren = fan_out;
+        node->mChildren = new aiNode *[fan_out];
+        for (unsigned int i = 0; i < fan_out; ++i) {
+            node->mChildren[i] = CreateNodeTree(depth - 1, fan_out, name_prefix, level + 1);
+            node->mChildren[i]->mParent = node;
+        }
+    }
+
+    return node;
+}
+
+#endif // BENCHMARKS_FIXTURES_H_
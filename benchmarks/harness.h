@@ -0,0 +1,142 @@
+#ifndef BENCHMARKS_HARNESS_H_
+#define BENCHMARKS_HARNESS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../lib/bench.h"
+
+#define BENCHMARK_REPETITIONS 5        // timed batches per benchmark, the median is reported
+#define BENCHMARK_MIN_BATCH_TIME 0.02  // seconds, batches grow until they take at least this long
+
+/**
+ * Keep the compiler from optimizing away a value that is otherwise unused.
+ */
+template <typename T> inline void DoNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+/**
+ * Minimal CPU microbenchmark runner, needs neither a window nor an OpenGL context.
+ *
+ * Accepted arguments:
+ *   --filter <text>   only run benchmarks whose name contains text
+ *   --json <path>     also write the results to a JSON report
+ */
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(int argc, char **argv) {
+        for (int i = 1; i < argc; ++i) {
+            auto arg = std::string(argv[i]);
+            if (arg == "--filter" && i + 1 < argc) {
+                filter_ = argv[++i];
+            } else if (arg == "--json" && i + 1 < argc) {
+                json_path_ = argv[++i];
+            } else {
+                std::fprintf(stderr, "Usage: %s [--filter <text>] [--json <path>]\n", argv[0]);
+                std::exit(-1);
+            }
+        }
+
+        std::printf("%-48s %14s %16s %12s\n", "benchmark", "time/op", "items/s", "iterations");
+    }
+
+    /**
+     * @param items_per_op units of work done by one call of op, e.g. vertices, for the throughput column
+     */
+    template <typename Op> void Run(const std::string &name, double items_per_op, Op &&op) {
+        if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+            return;
+        }
+
+        op(); // warm caches and lazy allocations
+
+        // grow the batch until timer resolution does not matter
+
+        size_t iterations = 1;
+        while (TimeBatch(op, iterations) < BENCHMARK_MIN_BATCH_TIME && iterations < (size_t(1) << 30)) {
+            iterations *= 2;
+        }
+
+        std::vector<double> samples;
+        for (size_t i = 0; i < BENCHMARK_REPETITIONS; ++i) {
+            samples.push_back(TimeBatch(op, iterations) / double(iterations));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result{
+            .name = name,
+            .seconds_per_op = samples[samples.size() / 2],
+            .items_per_second = items_per_op / samples[samples.size() / 2],
+            .iterations = iterations,
+        };
+        results_.push_back(result);
+
+        std::printf("%-48s %11.1f ns %14.3fM %12zu\n",
+                    name.c_str(),
+                    result.seconds_per_op * 1e9,
+                    result.items_per_second / 1e6,
+                    iterations);
+    }
+
+    /**
+     * @return process exit code
+     */
+    int Finish() const {
+        if (json_path_.empty()) {
+            return 0;
+        }
+
+        std::ofstream file(json_path_);
+        if (!file) {
+            std::fprintf(stderr, "ERROR: Failed to open benchmark report %s\n", json_path_.c_str());
+            return -1;
+        }
+
+        JsonWriter json(file);
+        json.BeginObject();
+        for (const auto &result : results_) {
+            json.BeginObject(result.name);
+            json.Number("ns_per_op", result.seconds_per_op * 1e9);
+            json.Number("items_per_second", result.items_per_second);
+            json.Number("iterations", double(result.iterations));
+            json.EndObject();
+        }
+        json.EndObject();
+
+        return 0;
+    }
+
+private:
+    struct Result {
+        std::string name;
+        double seconds_per_op;
+        double items_per_second;
+        size_t iterations;
+    };
+
+    std::string filter_, json_path_;
+    std::vector<Result> results_;
+
+    template <typename Op> static double TimeBatch(Op &op, size_t iterations) {
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            op();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double>(end - begin).count();
+    }
+};
+
+#endif // BENCHMARKS_HARNESS_H_
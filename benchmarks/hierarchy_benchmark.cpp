@@ -0,0 +1,47 @@
+#include "fixtures.h"
+#include "harness.h"
+
+#include "../lib/models/node.h"
+
+/**
+ * Time propagating a root rotation through the whole hierarchy, the sweep the first bounds query of a frame does after
+ * nodes moved, when drawing culls the root.
+ *
+ * @param fan_out children of every inner node, 1 for a chain
+ */
+void BenchmarkUpdateTransform(BenchmarkRunner &runner,
+                              const std::string &name,
+                              unsigned int depth,
+                              unsigned int fan_out) {
+    auto root = CreateNodeTree(depth, fan_out, "node");
+
+    TextureManager textures;
+    Node node(root, nullptr, "", textures, nullptr);
+
+    double n_nodes = 0;
+    for (unsigned int level = 0, width = 1; level <= depth; ++level, width *= fan_out) {
+        n_nodes += width;
+    }
+
+    runner.Run(name, n_nodes, [&]() {
+        node.Rotate(0.0f, 0.001f, 0.0f);
+        DoNotOptimize(node.GetBounds());
+        DoNotOptimize(node.GetWorldTransform());
+    });
+
+    delete root;
+}
+
+int main(int argc, char **argv) {
+    BenchmarkRunner runner(argc, argv);
+
+    for (auto depth : {4u, 16u, 64u, 256u}) {
+        BenchmarkUpdateTransform(runner, "update_transform/chain_depth:" + std::to_string(depth), depth - 1, 1);
+    }
+
+    for (auto depth : {4u, 8u, 12u}) {
+        BenchmarkUpdateTransform(runner, "update_transform/binary_depth:" + std::to_string(depth), depth - 1, 2);
+    }
+
+    return runner.Finish();
+}
@@ -0,0 +1,84 @@
+#include "fixtures.h"
+#include "harness.h"
+
+#include "../lib/kinematics/inverse.h"
+
+/**
+ * Chain of unit-length bones along y, with a target out of reach so that every Solve() step does the full work.
+ */
+class ChainFixture {
+public:
+    explicit ChainFixture(unsigned int n_bones)
+        : root_(CreateNodeTree(n_bones - 1, 1, "bone")), node_(root_, nullptr, "", textures_, nullptr) {
+        auto limit = glm::vec2(-1000.0f, 1000.0f);
+        for (unsigned int i = 0; i < n_bones; ++i) {
+            Node *node = nullptr;
+            node_.FindByName("bone" + std::to_string(i), node);
+            bones_.push_back(new Bone(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), limit, limit, limit, 0.1f, node));
+        }
+
+        chain_ = new BoneChain(bones_);
+        target_ = glm::vec3(float(n_bones) * 2.0f, float(n_bones) * 2.0f, float(n_bones));
+    }
+
+    ~ChainFixture() {
+        delete chain_;
+        for (auto bone : bones_) {
+            delete bone;
+        }
+        delete root_;
+    }
+
+    [[nodiscard]] BoneChain *GetChain() const { return chain_; }
+
+    [[nodiscard]] Bone *GetEnd() const { return bones_.back(); }
+
+    [[nodiscard]] const std::vector<Bone *> &GetBones() const { return bones_; }
+
+    [[nodiscard]] glm::vec3 GetTarget() const { return target_; }
+
+private:
+    aiNode *root_;
+    TextureManager textures_;
+    Node node_;
+
+    std::vector<Bone *> bones_;
+    BoneChain *chain_;
+
+    glm::vec3 target_;
+};
+
+void BenchmarkSolve(BenchmarkRunner &runner, unsigned int n_bones) {
+    ChainFixture fixture(n_bones);
+
+    runner.Run("bone_chain_solve/bones:" + std::to_string(n_bones), double(n_bones), [&]() {
+        DoNotOptimize(fixture.GetChain()->Solve(fixture.GetTarget(), 1e-6f));
+    });
+}
+
+void BenchmarkJacobian(BenchmarkRunner &runner, unsigned int n_bones) {
+    ChainFixture fixture(n_bones);
+    auto end_position = fixture.GetEnd()->GetEndPosition();
+
+    runner.Run("bone_jacobian/bones:" + std::to_string(n_bones), double(n_bones) * 3, [&]() {
+        for (auto bone : fixture.GetBones()) {
+            DoNotOptimize(bone->Jacobian(end_position, glm::vec3(1.0f, 0.0f, 0.0f)));
+            DoNotOptimize(bone->Jacobian(end_position, glm::vec3(0.0f, 1.0f, 0.0f)));
+            DoNotOptimize(bone->Jacobian(end_position, glm::vec3(0.0f, 0.0f, 1.0f)));
+        }
+    });
+}
+
+int main(int argc, char **argv) {
+    BenchmarkRunner runner(argc, argv);
+
+    for (auto n_bones : {2u, 5u, 10u, 20u, 40u}) {
+        BenchmarkSolve(runner, n_bones);
+    }
+
+    for (auto n_bones : {2u, 5u, 10u, 20u, 40u}) {
+        BenchmarkJacobian(runner, n_bones);
+    }
+
+    return runner.Finish();
+}
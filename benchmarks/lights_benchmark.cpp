@@ -0,0 +1,49 @@
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "harness.h"
+
+#include "../lib/shaders/light_grid.h"
+
+/**
+ * Time assigning point lights scattered through a corridor-like box in front of the camera to the light grid.
+ *
+ * @param radius radius of every light, larger lights overlap more clusters
+ */
+void BenchmarkBuild(BenchmarkRunner &runner, const std::string &name, unsigned int n_lights, float radius) {
+    std::mt19937 random(0);
+    std::uniform_real_distribution<float> across(-5.0f, 5.0f), along(-100.0f, 0.0f);
+
+    LightGrid grid;
+    for (unsigned int i = 0; i < n_lights; ++i) {
+        grid.AddLight(PointLight{
+            .position = glm::vec3(across(random), across(random) * 0.5f, along(random)),
+            .radius = radius,
+            .color = glm::vec3(1.0f),
+        });
+    }
+
+    auto view_matrix = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    auto projection_matrix = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    runner.Run(name, n_lights, [&]() {
+        grid.Build(view_matrix, projection_matrix, 0.1f, 100.0f, 1920, 1080);
+        DoNotOptimize(grid.GetIndices().data());
+    });
+}
+
+int main(int argc, char **argv) {
+    BenchmarkRunner runner(argc, argv);
+
+    for (auto n_lights : {16u, 256u, 1024u, 4096u}) {
+        BenchmarkBuild(runner, "light_grid_build/lights:" + std::to_string(n_lights) + "/radius:1", n_lights, 1.0f);
+    }
+
+    for (auto radius : {0.5f, 2.0f, 8.0f}) {
+        auto name = "light_grid_build/lights:1024/radius:" + std::to_string(radius).substr(0, 3);
+        BenchmarkBuild(runner, name, 1024, radius);
+    }
+
+    return runner.Finish();
+}
@@ -0,0 +1,147 @@
+#include <random>
+
+#include "fixtures.h"
+#include "harness.h"
+
+#include "../lib/models/mesh.h"
+
+#define N_DELTA_SHAPES 24 // as many as the vertex_pick blendshapes
+
+void BenchmarkDeltaAccumulation(BenchmarkRunner &runner, unsigned int n_vertices) {
+    auto base = CreateMesh(n_vertices, 0);
+    Mesh mesh(base);
+
+    for (unsigned int i = 0; i < N_DELTA_SHAPES; ++i) {
+        auto delta = CreateMesh(n_vertices, i + 1);
+        mesh.LoadDeltaMesh(delta);
+        mesh.SetDeltaWeight(i, float(i) / N_DELTA_SHAPES);
+        delete delta;
+    }
+
+    runner.Run("delta_accumulation/vertices:" + std::to_string(n_vertices),
+               double(n_vertices) * N_DELTA_SHAPES,
+               [&]() {
+                   mesh.AccumulateDeltaWeights();
+                   DoNotOptimize(mesh.GetDeltaWeighted()[0]);
+               });
+
+    delete base;
+}
+
+void BenchmarkLoadVertices(BenchmarkRunner &runner, unsigned int n_vertices) {
+    auto source = CreateMesh(n_vertices, 0);
+
+    runner.Run("load_vertices/vertices:" + std::to_string(n_vertices), double(n_vertices), [&]() {
+        Mesh mesh(source);
+        DoNotOptimize(mesh);
+    });
+
+    delete source;
+}
+
+void BenchmarkLoadGrid(BenchmarkRunner &runner, unsigned int side) {
+    auto source = CreateGridMesh(side, 0);
+
+    runner.Run("load_grid/vertices:" + std::to_string(side * side), double(side * side), [&]() {
+        Mesh mesh(source);
+        DoNotOptimize(mesh);
+    });
+
+    delete source;
+}
+
+void BenchmarkSimplify(BenchmarkRunner &runner, unsigned int side) {
+    auto source = CreateGridMesh(side, 0);
+
+    std::vector<glm::vec3> positions;
+    positions.reserve(source->mNumVertices);
+    for (unsigned int i = 0; i < source->mNumVertices; ++i) {
+        positions.emplace_back(source->mVertices[i].x, source->mVertices[i].y, source->mVertices[i].z);
+    }
+
+    std::vector<unsigned int> indices;
+    indices.reserve(source->mNumFaces * 3);
+    for (unsigned int i = 0; i < source->mNumFaces; ++i) {
+        indices.insert(indices.end(), source->mFaces[i].mIndices, source->mFaces[i].mIndices + 3);
+    }
+
+    // a full chain, each level half of the previous one
+    runner.Run("simplify/vertices:" + std::to_string(side * side), double(indices.size() / 3), [&]() {
+        MeshSimplifier simplifier(indices, positions);
+        for (auto level = 1; level < MESH_LOD_MAX_LEVELS; ++level) {
+            DoNotOptimize(simplifier.Simplify(indices.size() / 3 >> level, INFINITY).size());
+        }
+    });
+
+    delete source;
+}
+
+void BenchmarkVertexEncode(BenchmarkRunner &runner, const VertexLayout &layout, unsigned int n_vertices) {
+    auto source = CreateMesh(n_vertices, 0);
+
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(n_vertices);
+    for (unsigned int i = 0; i < n_vertices; ++i) {
+        vertices.emplace_back(glm::vec3(source->mVertices[i].x, source->mVertices[i].y, source->mVertices[i].z));
+        vertices.back().normal = glm::normalize(glm::vec3(source->mNormals[i].x, source->mNormals[i].y, 1.0f));
+        vertices.back().uv = glm::vec2(source->mTextureCoords[0][i].x, source->mTextureCoords[0][i].y);
+    }
+
+    VertexQuantization quantization{.min = glm::vec3(-1.0f), .extent = glm::vec3(2.0f)};
+    std::vector<uint8_t> encoded(n_vertices * layout.stride);
+
+    runner.Run(std::string("vertex_encode/") + layout.name + "/vertices:" + std::to_string(n_vertices),
+               double(n_vertices),
+               [&]() {
+                   layout.encode(vertices.data(), vertices.size(), quantization, encoded.data());
+                   DoNotOptimize(encoded[0]);
+               });
+
+    delete source;
+}
+
+void BenchmarkPickScan(BenchmarkRunner &runner, unsigned int n_vertices) {
+    std::mt19937 random(0);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+    std::vector<GLfloat> distances(n_vertices);
+    for (auto &distance : distances) {
+        distance = distribution(random);
+    }
+
+    runner.Run("pick_min_scan/vertices:" + std::to_string(n_vertices), double(n_vertices), [&]() {
+        DoNotOptimize(Mesh::FindMinimum(distances.data(), distances.size()));
+    });
+}
+
+int main(int argc, char **argv) {
+    BenchmarkRunner runner(argc, argv);
+
+    for (auto n_vertices : {1024u, 16384u, 131072u}) {
+        BenchmarkDeltaAccumulation(runner, n_vertices);
+    }
+
+    for (auto n_vertices : {1024u, 16384u, 131072u}) {
+        BenchmarkLoadVertices(runner, n_vertices);
+    }
+
+    for (auto side : {128u, 362u}) {
+        BenchmarkLoadGrid(runner, side);
+    }
+
+    for (auto side : {128u, 362u}) {
+        BenchmarkSimplify(runner, side);
+    }
+
+    for (const auto &layout : kVertexLayouts) {
+        for (auto n_vertices : {16384u, 131072u}) {
+            BenchmarkVertexEncode(runner, layout, n_vertices);
+        }
+    }
+
+    for (auto n_vertices : {1024u, 16384u, 131072u, 1048576u}) {
+        BenchmarkPickScan(runner, n_vertices);
+    }
+
+    return runner.Finish();
+}
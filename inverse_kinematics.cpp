@@ -25,10 +25,6 @@ public:
         }
 
         shader_ = new ShaderProgram("shaders/phong.vert", "shaders/cook-torrance.frag");
-        if (!shader_->IsReady()) {
-            printf("FATAL: Failed to initialize shaders.\n");
-            return false;
-        }
         shaders_.push_back(shader_);
 
         if (!Scene::CreateFromFile("resources/models/robotic_arm/scene.gltf", arm_, textures_) ||
@@ -73,6 +69,27 @@ public:
             return false;
         }
 
+        if (!shader_->IsReady()) {
+            printf("FATAL: Failed to initialize shaders.\n");
+            return false;
+        }
+
+        // values edited through ImGui, replayed from input logs
+
+        TrackValue("velocity", &velocity_);
+        TrackValue("enable_solver", &enable_solver_);
+        TrackValue("two_bones", &two_bones_);
+        TrackValue("track_crate", &track_crate_);
+        TrackValue("track_sine", &track_sine_);
+        TrackValue("target_x", &target_x);
+        TrackValue("target_y", &target_y);
+        TrackValue("target_z", &target_z);
+        TrackValue("enable_animation", &enable_animation_);
+        TrackValue("animation_speed", &animation_speed_);
+        TrackValue("draw_end_position", &draw_end_position_);
+        TrackValue("draw_model", &draw_model_);
+        TrackValue("draw_target", &draw_target_);
+
         return glCheckError() == GL_NO_ERROR;
     };
 
@@ -152,15 +169,12 @@ private:
 
         // draw
 
-        shader_->Use();
-
         if (draw_model_) {
-            arm_->Draw(shader_);
+            DrawOpaque({{arm_, shader_}, {crate_, shader_}, {table_, shader_}});
+        } else {
+            DrawOpaque({{crate_, shader_}, {table_, shader_}});
         }
 
-        crate_->Draw(shader_);
-        table_->Draw(shader_);
-
         if (draw_end_position_) {
             for (auto &joint : joints_) {
                 auto end = joint->GetEndPosition();
@@ -323,8 +337,11 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char **argv) {
     InverseKinematicsProgram program;
+    if (!program.ParseCommandLine(argc, argv)) {
+        return -1;
+    }
     if (!program.Initialize("CS7GV5: Inverse Kinematics")) {
         return -1;
     }
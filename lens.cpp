@@ -22,7 +22,8 @@ private:
     GLuint blur_fbo_ = 0, blur_color_rto_ = 0, blur_depth_rbo_ = 0;
 
     GLuint depth_pick_tfo_ = 0, depth_pick_query_ = 0;
-    GLuint depth_pick_vao_ = 0, depth_pick_vbo_out_ = 0;
+    GLuint depth_pick_vao_ = 0;
+    ReadbackRing depth_pick_readback_;
     GLfloat picked_depth_[4] = {2.718281828459045f};
     bool enable_depth_pick_ = true;
 
@@ -51,61 +52,71 @@ private:
     void Draw() override {
         // draw world to texture
 
-        Program::DrawTo(fbo_);
+        {
+            GpuTimerScope scope(gpu_timer_, "scene");
 
-        phong_->Use();
-        obj_->Draw(phong_);
+            Program::DrawTo(fbo_);
 
-        glCheckError();
+            DrawOpaque({{obj_, phong_}});
+
+            glCheckError();
+        }
 
         // draw blurred texture to levels
 
-        Program::DrawTo(blur_fbo_);
+        {
+            GpuTimerScope scope(gpu_timer_, "blur");
 
-        blur_->Use();
+            Program::DrawTo(blur_fbo_);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, color_rto_);
+            blur_->Use();
 
-        blur_->SetInt("colorTexture", 0);
+            GlStateCache::GetInstance().BindTexture(0, GL_TEXTURE_2D, color_rto_);
 
-        DrawQuad();
-        glCheckError();
+            blur_->SetInt("colorTexture", 0);
+
+            DrawQuad();
+            glCheckError();
+        }
 
         // draw levels with lens shader
 
-        Program::Draw();
+        {
+            GpuTimerScope scope(gpu_timer_, "composite");
 
-        len_->Use();
+            Program::Draw();
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, blur_color_rto_);
-        len_->SetInt("colorTexture", 0);
+            len_->Use();
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depth_rto_);
-        len_->SetInt("depthTexture", 1);
+            GlStateCache::GetInstance().BindTexture(0, GL_TEXTURE_2D_ARRAY, blur_color_rto_);
+            len_->SetInt("colorTexture", 0);
 
-        len_->SetFloat("focusDistance", depth_focus_);
-        len_->SetFloat("focusDistanceMax", depth_focus_max_);
-        len_->SetFloat("focusStep", depth_step_);
+            GlStateCache::GetInstance().BindTexture(1, GL_TEXTURE_2D, depth_rto_);
+            len_->SetInt("depthTexture", 1);
 
-        len_->SetInt("drawDepth", draw_depth_texture_);
-        len_->SetFloat("drawDepthMax", depth_scale_max_);
-        len_->SetFloat("drawDepthMin", depth_scale_min_);
+            len_->SetFloat("focusDistance", depth_focus_);
+            len_->SetFloat("focusDistanceMax", depth_focus_max_);
+            len_->SetFloat("focusStep", depth_step_);
 
-        len_->SetInt("drawBlur", draw_blur_);
-        len_->SetInt("drawBlurLevel", draw_blur_level_);
+            len_->SetInt("drawDepth", draw_depth_texture_);
+            len_->SetFloat("drawDepthMax", depth_scale_max_);
+            len_->SetFloat("drawDepthMin", depth_scale_min_);
 
-        len_->SetFloat("zFar", Z_FAR);
-        len_->SetFloat("zNear", Z_NEAR);
+            len_->SetInt("drawBlur", draw_blur_);
+            len_->SetInt("drawBlurLevel", draw_blur_level_);
 
-        DrawQuad();
-        glCheckError();
+            len_->SetFloat("zFar", Z_FAR);
+            len_->SetFloat("zNear", Z_NEAR);
+
+            DrawQuad();
+            glCheckError();
+        }
 
         // pick depth
 
         if (enable_depth_pick_) {
+            GpuTimerScope scope(gpu_timer_, "depth_pick");
+
             PickDepth();
             depth_focus_ = picked_depth_[0];
         }
@@ -146,13 +157,13 @@ private:
     }
 
     void DrawQuad() const {
-        glBindVertexArray(null_vao_);
+        GlStateCache::GetInstance().BindVertexArray(null_vao_);
         glDrawArrays(GL_TRIANGLES, 0, 3);
     }
 
     glm::vec2 GetCursorPosition() const {
         double x, y;
-        glfwGetCursorPos(window_, &x, &y);
+        GetCursorPos(x, y);
         return {x / window_width_, 1 - y / window_height_};
     }
 
@@ -175,32 +186,12 @@ private:
         camera_->SetPosition(2.5, 0.4, 0.15);
         camera_->SetRotation(0.0f, -170.0f);
 
-        // load shaders
+        // start compiling shaders, they are waited for once everything else is loaded
 
         phong_ = new ShaderProgram("shaders/phong.vert", "shaders/blinn-phong.frag");
-        if (!phong_->IsReady()) {
-            std::cerr << "FATAL: Failed to initialize phong shader" << std::endl;
-            return false;
-        }
-
         blur_ = new ShaderProgram("shaders/lens/screen.vert", "shaders/lens/blur.geom", "shaders/lens/blur.frag");
-        if (!blur_->IsReady()) {
-            std::cerr << "FATAL: Failed to initialize blur shader" << std::endl;
-            return false;
-        }
-
         len_ = new ShaderProgram("shaders/lens/screen.vert", "shaders/lens/lens.frag");
-        if (!len_->IsReady()) {
-            std::cerr << "FATAL: Failed to initialize lens shader" << std::endl;
-            return false;
-        }
-
         tex_ = new ShaderProgram("shaders/lens/screen.vert", "shaders/lens/screen.frag");
-        if (!tex_->IsReady()) {
-            std::cerr << "FATAL: Failed to initialize texture debug shader" << std::endl;
-            return false;
-        }
-
         depth_pick_ = new FeedbackShaderProgram(
             {
                 {"shaders/lens/depth-pick.vert", GL_VERTEX_SHADER},
@@ -208,10 +199,6 @@ private:
                 {"shaders/lens/depth-pick.frag", GL_FRAGMENT_SHADER},
             },
             {"gDepth"});
-        if (!depth_pick_->IsReady()) {
-            std::cerr << "FATAL: Failed to initialize picker shader" << std::endl;
-            return false;
-        }
 
         shaders_.push_back(phong_);
         shaders_.push_back(blur_);
@@ -291,10 +278,10 @@ private:
         glGenTransformFeedbacks(1, &depth_pick_tfo_);
         glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, depth_pick_tfo_);
 
-        glGenBuffers(1, &depth_pick_vbo_out_);
-        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, depth_pick_vbo_out_);
-        glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, sizeof(picked_depth_), &picked_depth_[0], GL_DYNAMIC_READ);
-        glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, depth_pick_vbo_out_, 0, sizeof(picked_depth_));
+        if (!depth_pick_readback_.Initialize(sizeof(picked_depth_))) {
+            std::cerr << "FATAL: Failed to initialize depth picking buffers" << std::endl;
+            return false;
+        }
 
         glGenQueries(1, &depth_pick_query_);
 
@@ -303,24 +290,66 @@ private:
 
         glCheckError();
 
+        // wait for the shaders of the first frame, the texture debug shader finishes when first used
+
+        if (!phong_->IsReady()) {
+            std::cerr << "FATAL: Failed to initialize phong shader" << std::endl;
+            return false;
+        }
+
+        if (!blur_->IsReady()) {
+            std::cerr << "FATAL: Failed to initialize blur shader" << std::endl;
+            return false;
+        }
+
+        if (!len_->IsReady()) {
+            std::cerr << "FATAL: Failed to initialize lens shader" << std::endl;
+            return false;
+        }
+
+        if (!depth_pick_->IsReady()) {
+            std::cerr << "FATAL: Failed to initialize picker shader" << std::endl;
+            return false;
+        }
+
+        // values edited through ImGui, replayed from input logs
+
+        TrackValue("depth_focus", &depth_focus_);
+        TrackValue("depth_focus_max", &depth_focus_max_);
+        TrackValue("depth_step", &depth_step_);
+        TrackValue("draw_depth_texture", &draw_depth_texture_);
+        TrackValue("depth_scale_max", &depth_scale_max_);
+        TrackValue("depth_scale_min", &depth_scale_min_);
+        TrackValue("draw_blur", &draw_blur_);
+        TrackValue("draw_blur_level", &draw_blur_level_);
+        TrackValue("enable_depth_pick", &enable_depth_pick_);
+
         // re-apply window size
 
-        glfwGetWindowSize(window_, &window_width_, &window_height_);
-        glfwSetWindowSize(window_, window_width_, window_height_);
+        if (window_ != nullptr) {
+            glfwGetWindowSize(window_, &window_width_, &window_height_);
+            glfwSetWindowSize(window_, window_width_, window_height_);
+        }
 
         return true;
     }
 
+    /**
+     * Reads back the depth picked READBACK_FRAMES - 1 frames ago, then picks the depth under the cursor for this frame.
+     */
     void PickDepth() {
+        // consume an earlier frame's result, picked_depth_ keeps its last value until the GPU has finished one
+
+        depth_pick_readback_.Read(&picked_depth_[0]);
+
         // configure drawing
 
-        glBindVertexArray(null_vao_);
+        GlStateCache::GetInstance().BindVertexArray(null_vao_);
 
         depth_pick_->Use();
         depth_pick_->SetVec2("cursorPosition", GetCursorPosition());
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, depth_rto_);
+        GlStateCache::GetInstance().BindTexture(0, GL_TEXTURE_2D, depth_rto_);
         depth_pick_->SetInt("depthTexture", 0);
 
         glCheckError();
@@ -332,6 +361,8 @@ private:
             std::cerr << "FATAL: Failed to bind transform feedback object" << std::endl;
             return;
         }
+        glBindBufferRange(
+            GL_TRANSFORM_FEEDBACK_BUFFER, 0, depth_pick_readback_.GetWriteBuffer(), 0, sizeof(picked_depth_));
         glBeginTransformFeedback(GL_LINES);
         glCheckError();
 
@@ -340,12 +371,10 @@ private:
         glDrawArrays(GL_POINTS, 0, 1);
         glCheckError();
 
-        // read back
-
         glEndTransformFeedback();
         glCheckError();
 
-        glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, sizeof(picked_depth_), &picked_depth_[0]);
+        depth_pick_readback_.EndWrite();
     }
 
     void ResizeRenderTarget() {
@@ -384,8 +413,11 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char **argv) {
     LensProgram program;
+    if (!program.ParseCommandLine(argc, argv)) {
+        return -1;
+    }
     if (program.Initialize("Lens")) {
         program.Run();
         return 0;
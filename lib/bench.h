@@ -0,0 +1,124 @@
+#ifndef LIB_BENCH_H_
+#define LIB_BENCH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cameras/common.h"
+
+struct BenchOptions {
+    bool enabled = false;
+    size_t frames = 600;       // number of recorded frames
+    size_t warmup_frames = 10; // frames rendered before recording starts
+    std::string output_path = "bench.json";
+};
+
+/**
+ * Deterministic camera motion for benchmark runs: one full yaw revolution over the recorded frames, with a gentle
+ * pitch sway. Offsets are applied incrementally through BaseCamera::Rotate, so it works for both camera types.
+ */
+class BenchCameraPath {
+public:
+    explicit BenchCameraPath(size_t n_frames, float pitch_amplitude = 10.0f)
+        : n_frames_(std::max(n_frames, size_t(1))), pitch_amplitude_(pitch_amplitude) {}
+
+    void Apply(BaseCamera *camera, size_t frame) const {
+        auto pitch_delta = GetPitch(frame + 1) - GetPitch(frame);
+        auto yaw_delta = 360.0f / float(n_frames_);
+
+        camera->Rotate(pitch_delta / camera->rotate_speed, yaw_delta / camera->rotate_speed);
+    }
+
+private:
+    size_t n_frames_;
+    float pitch_amplitude_;
+
+    [[nodiscard]] float GetPitch(size_t frame) const {
+        return pitch_amplitude_ * std::sin(2.0f * 3.14159265358979f * float(frame) / float(n_frames_));
+    }
+};
+
+/**
+ * Minimal streaming JSON writer for benchmark reports.
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream &out) : out_(out) {}
+
+    void BeginObject() { BeginValue("", '{'); }
+
+    void BeginObject(const std::string &key) { BeginValue(key, '{'); }
+
+    void EndObject() { EndValue('}'); }
+
+    void Number(const std::string &key, double value) {
+        WriteKey(key);
+        if (std::isfinite(value)) {
+            out_ << value;
+        } else {
+            out_ << "null";
+        }
+    }
+
+    void String(const std::string &key, const std::string &value) {
+        WriteKey(key);
+        WriteString(value);
+    }
+
+private:
+    std::ostream &out_;
+    std::vector<bool> has_items_;
+
+    void BeginValue(const std::string &key, char bracket) {
+        if (!has_items_.empty()) {
+            WriteKey(key);
+        }
+        out_ << bracket;
+        has_items_.push_back(false);
+    }
+
+    void EndValue(char bracket) {
+        has_items_.pop_back();
+        out_ << "\n" << std::string(has_items_.size() * 2, ' ') << bracket;
+        if (has_items_.empty()) {
+            out_ << "\n";
+        }
+    }
+
+    void WriteKey(const std::string &key) {
+        if (has_items_.back()) {
+            out_ << ",";
+        }
+        has_items_.back() = true;
+
+        out_ << "\n" << std::string(has_items_.size() * 2, ' ');
+        WriteString(key);
+        out_ << ": ";
+    }
+
+    void WriteString(const std::string &value) {
+        out_ << '"';
+        for (auto c : value) {
+            switch (c) {
+            case '"':
+                out_ << "\\\"";
+                break;
+            case '\\':
+                out_ << "\\\\";
+                break;
+            case '\n':
+                out_ << "\\n";
+                break;
+            default:
+                out_ << c;
+                break;
+            }
+        }
+        out_ << '"';
+    }
+};
+
+#endif // LIB_BENCH_H_
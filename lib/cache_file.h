@@ -0,0 +1,95 @@
+#ifndef LIB_CACHE_FILE_H_
+#define LIB_CACHE_FILE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+
+/**
+ * 64-bit FNV-1a hash of everything a cache entry depends on.
+ */
+class CacheKey {
+public:
+    void Add(const void *data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash_ = (hash_ ^ ((const uint8_t *)data)[i]) * 1099511628211ull;
+        }
+    }
+
+    /**
+     * Hash a string with its terminator, so consecutive strings cannot run into each other.
+     */
+    void Add(const std::string &value) { Add(value.c_str(), value.size() + 1); }
+
+    [[nodiscard]] uint64_t Get() const { return hash_; }
+
+private:
+    uint64_t hash_ = 14695981039346656037ull;
+};
+
+/**
+ * Directory of cache entries, one file per key.
+ */
+class CacheDirectory {
+public:
+    /**
+     * @param extension of the entry files, without the dot
+     * @param name of the cache, for warnings
+     */
+    CacheDirectory(std::filesystem::path directory, const char *extension, const char *name)
+        : directory_(std::move(directory)), extension_(extension), name_(name) {}
+
+    void Set(const std::filesystem::path &directory) { directory_ = directory; }
+
+    [[nodiscard]] std::filesystem::path GetPath(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.%s", (unsigned long long)key, extension_);
+        return directory_ / name;
+    }
+
+    /**
+     * Write an entry, replacing any previous one.
+     *
+     * @param write called with the stream to write the entry into
+     */
+    template <typename Writer> void Write(uint64_t key, Writer &&write) const {
+        std::error_code error;
+        std::filesystem::create_directories(directory_, error);
+
+        // write aside and rename, a concurrently starting program never reads a partial entry
+
+        auto path = GetPath(key);
+        auto temporary_path = std::filesystem::path(path).concat(".tmp");
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            write(file);
+            if (!file) {
+                std::cerr << "WARNING: Failed to write " << name_ << " entry " << temporary_path << std::endl;
+                return;
+            }
+        }
+
+        std::filesystem::rename(temporary_path, path, error);
+        if (error) {
+            std::cerr << "WARNING: Failed to write " << name_ << " entry " << path << ": " << error.message()
+                      << std::endl;
+            std::filesystem::remove(temporary_path, error);
+        }
+    }
+
+    void Remove(uint64_t key) const {
+        std::error_code error;
+        std::filesystem::remove(GetPath(key), error);
+    }
+
+private:
+    std::filesystem::path directory_;
+    const char *extension_;
+    const char *name_;
+};
+
+#endif // LIB_CACHE_FILE_H_
@@ -0,0 +1,220 @@
+#ifndef LIB_GL_STATE_H_
+#define LIB_GL_STATE_H_
+
+#include <array>
+
+#include <glad/glad.h>
+
+#include "utils.h"
+
+#define GL_STATE_TEXTURE_UNITS 32 // units tracked, binds to higher units always go to the driver
+
+// ARB_multi_bind, core since 4.4 and not part of the 4.3 glad loader
+
+typedef void(APIENTRYP PFNGLBINDTEXTURESPROC_)(GLuint first, GLsizei count, const GLuint *textures);
+
+/**
+ * Binds issued to and skipped by the GlStateCache.
+ */
+struct GlStateCounters {
+    size_t program_binds = 0, program_skips = 0;
+    size_t vertex_array_binds = 0, vertex_array_skips = 0;
+    size_t texture_binds = 0, texture_skips = 0;
+    size_t active_texture_changes = 0, active_texture_skips = 0;
+
+    GlStateCounters &operator+=(const GlStateCounters &other) {
+        program_binds += other.program_binds;
+        program_skips += other.program_skips;
+        vertex_array_binds += other.vertex_array_binds;
+        vertex_array_skips += other.vertex_array_skips;
+        texture_binds += other.texture_binds;
+        texture_skips += other.texture_skips;
+        active_texture_changes += other.active_texture_changes;
+        active_texture_skips += other.active_texture_skips;
+        return *this;
+    }
+};
+
+/**
+ * Shadow copy of the bound program, vertex array and textures, skips GL calls that would not change them.
+ *
+ * The cache only knows about binds made through it. Code that binds directly, or deletes bound objects, must call
+ * Invalidate() afterwards; the program loop invalidates at the start of every frame, so loading and resizing code can
+ * keep binding directly.
+ */
+class GlStateCache {
+public:
+    static GlStateCache &GetInstance() {
+        static GlStateCache instance;
+        return instance;
+    }
+
+    /**
+     * @param loader for glBindTextures, which glad does not load
+     */
+    void Initialize(GLADloadproc loader) {
+        bind_textures_ = nullptr;
+        if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4) ||
+            HasOpenGLExtension("GL_ARB_multi_bind")) {
+            bind_textures_ = (PFNGLBINDTEXTURESPROC_)loader("glBindTextures");
+        }
+    }
+
+    void UseProgram(GLuint program) {
+        if (program_ == program) {
+            ++counters_.program_skips;
+            return;
+        }
+
+        glUseProgram(program);
+        program_ = program;
+        ++counters_.program_binds;
+    }
+
+    void BindVertexArray(GLuint vertex_array) {
+        if (vertex_array_ == vertex_array) {
+            ++counters_.vertex_array_skips;
+            return;
+        }
+
+        glBindVertexArray(vertex_array);
+        vertex_array_ = vertex_array;
+        ++counters_.vertex_array_binds;
+    }
+
+    /**
+     * Bind a texture to a unit, only switching the active unit if the binding changes.
+     *
+     * @param unit texture unit, without GL_TEXTURE0
+     */
+    void BindTexture(GLuint unit, GLenum target, GLuint texture) {
+        auto slot = GetTargetSlot(target);
+        if (unit < GL_STATE_TEXTURE_UNITS && slot < kTargets && textures_[unit][slot] == texture) {
+            ++counters_.texture_skips;
+            return;
+        }
+
+        ActiveTexture(unit);
+        glBindTexture(target, texture);
+        ++counters_.texture_binds;
+
+        if (unit < GL_STATE_TEXTURE_UNITS && slot < kTargets) {
+            textures_[unit][slot] = texture;
+        }
+    }
+
+    /**
+     * Bind 2D textures to consecutive units, with a single glBindTextures where available. Skipped if all of them are
+     * bound already.
+     *
+     * @param first first texture unit, without GL_TEXTURE0
+     * @param textures one texture per unit, 0 leaves the unit empty
+     */
+    void BindTextures2D(GLuint first, GLsizei count, const GLuint *textures) {
+        auto slot = GetTargetSlot(GL_TEXTURE_2D);
+        auto bound = first + GLuint(count) <= GL_STATE_TEXTURE_UNITS;
+        for (GLsizei i = 0; bound && i < count; ++i) {
+            bound = textures_[first + i][slot] == textures[i];
+        }
+        if (bound) {
+            ++counters_.texture_skips;
+            return;
+        }
+
+        if (bind_textures_ == nullptr) {
+            for (GLsizei i = 0; i < count; ++i) {
+                BindTexture(first + GLuint(i), GL_TEXTURE_2D, textures[i]);
+            }
+            return;
+        }
+
+        bind_textures_(first, count, textures); // leaves the active unit alone
+        ++counters_.texture_binds;
+
+        for (GLsizei i = 0; i < count && first + GLuint(i) < GL_STATE_TEXTURE_UNITS; ++i) {
+            auto &unit = textures_[first + i];
+            if (textures[i] == 0) {
+                unit.fill(0); // a zero unbinds every target of the unit
+            } else {
+                unit[slot] = textures[i];
+            }
+        }
+    }
+
+    /**
+     * @param unit texture unit, without GL_TEXTURE0
+     */
+    void ActiveTexture(GLuint unit) {
+        if (active_texture_ == unit) {
+            ++counters_.active_texture_skips;
+            return;
+        }
+
+        glActiveTexture(GL_TEXTURE0 + unit);
+        active_texture_ = unit;
+        ++counters_.active_texture_changes;
+    }
+
+    /**
+     * Forget all cached state, the next bind of everything goes to the driver.
+     */
+    void Invalidate() {
+        program_ = vertex_array_ = kUnknown;
+        active_texture_ = kUnknown;
+        for (auto &unit : textures_) {
+            unit.fill(kUnknown);
+        }
+    }
+
+    /**
+     * Start counting a new frame, the counters of the finished one move to GetLastFrameCounters().
+     */
+    void BeginFrame() {
+        last_frame_counters_ = counters_;
+        totals_ += counters_;
+        counters_ = GlStateCounters();
+
+        Invalidate();
+    }
+
+    [[nodiscard]] const GlStateCounters &GetLastFrameCounters() const { return last_frame_counters_; }
+
+    /**
+     * @return counters summed over all finished frames since ResetTotals()
+     */
+    [[nodiscard]] const GlStateCounters &GetTotals() const { return totals_; }
+
+    void ResetTotals() { totals_ = GlStateCounters(); }
+
+private:
+    static constexpr GLuint kUnknown = ~GLuint(0);
+
+    static constexpr size_t kTargets = 3;
+
+    GLuint program_ = kUnknown, vertex_array_ = kUnknown, active_texture_ = kUnknown;
+    std::array<std::array<GLuint, kTargets>, GL_STATE_TEXTURE_UNITS> textures_{};
+
+    GlStateCounters counters_, last_frame_counters_, totals_;
+
+    PFNGLBINDTEXTURESPROC_ bind_textures_ = nullptr;
+
+    GlStateCache() { Invalidate(); }
+
+    /**
+     * @return index into a unit's bindings, kTargets for targets that are not cached
+     */
+    static size_t GetTargetSlot(GLenum target) {
+        switch (target) {
+        case GL_TEXTURE_2D:
+            return 0;
+        case GL_TEXTURE_2D_ARRAY:
+            return 1;
+        case GL_TEXTURE_CUBE_MAP:
+            return 2;
+        default:
+            return kTargets;
+        }
+    }
+};
+
+#endif // LIB_GL_STATE_H_
@@ -0,0 +1,152 @@
+#ifndef LIB_HEADLESS_H_
+#define LIB_HEADLESS_H_
+
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/**
+ * Window-less OpenGL context backed by EGL, for running programs on machines without a display.
+ *
+ * The context has no default framebuffer, callers must render into their own framebuffer objects.
+ */
+class HeadlessContext {
+public:
+    bool Initialize(int major_version, int minor_version) {
+#ifdef HAVE_EGL
+        display_ = GetDisplay();
+        if (display_ == EGL_NO_DISPLAY) {
+            std::cerr << "FATAL: Failed to get EGL display" << std::endl;
+            return false;
+        }
+
+        EGLint egl_major, egl_minor;
+        if (!eglInitialize(display_, &egl_major, &egl_minor)) {
+            std::cerr << "FATAL: Failed to initialize EGL" << std::endl;
+            return false;
+        }
+
+        std::cout << "INFO: EGL " << egl_major << "." << egl_minor << " initialized" << std::endl;
+
+        if (!HasExtension(eglQueryString(display_, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+            std::cerr << "FATAL: EGL display does not support surfaceless contexts" << std::endl;
+            return false;
+        }
+
+        const EGLint config_attributes[] = {
+            EGL_SURFACE_TYPE,
+            EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE,
+            EGL_OPENGL_BIT,
+            EGL_NONE,
+        };
+
+        EGLConfig config;
+        EGLint n_configs = 0;
+        if (!eglChooseConfig(display_, config_attributes, &config, 1, &n_configs) || n_configs == 0) {
+            std::cerr << "FATAL: Failed to choose EGL config" << std::endl;
+            return false;
+        }
+
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cerr << "FATAL: Failed to bind OpenGL API to EGL" << std::endl;
+            return false;
+        }
+
+        const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION,
+            major_version,
+            EGL_CONTEXT_MINOR_VERSION,
+            minor_version,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,
+            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE,
+        };
+
+        context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attributes);
+        if (context_ == EGL_NO_CONTEXT) {
+            std::cerr << "FATAL: Failed to create EGL context" << std::endl;
+            return false;
+        }
+
+        if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+            std::cerr << "FATAL: Failed to make EGL context current" << std::endl;
+            return false;
+        }
+
+        return true;
+#else
+        std::cerr << "FATAL: Headless mode requires EGL, which is not available in this build" << std::endl;
+        return false;
+#endif
+    }
+
+    void Destroy() {
+#ifdef HAVE_EGL
+        if (display_ != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context_ != EGL_NO_CONTEXT) {
+                eglDestroyContext(display_, context_);
+                context_ = EGL_NO_CONTEXT;
+            }
+            eglTerminate(display_);
+            display_ = EGL_NO_DISPLAY;
+        }
+#endif
+    }
+
+    static GLADloadproc GetProcAddressLoader() {
+#ifdef HAVE_EGL
+        return (GLADloadproc)eglGetProcAddress;
+#else
+        return nullptr;
+#endif
+    }
+
+private:
+#ifdef HAVE_EGL
+    EGLDisplay display_ = EGL_NO_DISPLAY;
+    EGLContext context_ = EGL_NO_CONTEXT;
+
+    static EGLDisplay GetDisplay() {
+        // prefer the surfaceless platform, it does not need a running X or Wayland server
+
+        auto client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (HasExtension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+            auto get_platform_display =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (get_platform_display != nullptr) {
+                auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+                if (display != EGL_NO_DISPLAY) {
+                    return display;
+                }
+            }
+        }
+
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    static bool HasExtension(const char *extensions, const char *name) {
+        if (extensions == nullptr) {
+            return false;
+        }
+
+        auto length = std::strlen(name);
+        for (auto p = std::strstr(extensions, name); p != nullptr; p = std::strstr(p + length, name)) {
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+#endif
+};
+
+#endif // LIB_HEADLESS_H_
@@ -44,8 +44,10 @@ public:
     [[nodiscard]] glm::mat4 GetWorldTransform() const { return node_->GetWorldTransform(); }
 
     glm::vec3 Jacobian(glm::vec3 end_position, glm::vec3 axis) {
-        axis = glm::mat3(node_->GetWorldTransform()) * axis;
-        return glm::cross(axis, end_position - node_->GetWorldPosition());
+        const auto &world_transform = node_->GetWorldTransform();
+
+        axis = glm::mat3(world_transform) * axis;
+        return glm::cross(axis, end_position - glm::vec3(world_transform[3]));
     }
 
 private:
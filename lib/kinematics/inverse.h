@@ -4,13 +4,21 @@
 #include <vector>
 
 #include "../models/node.h"
+#include "../profiling/trace.h"
 #include "bone.h"
 
 class BoneChain {
 public:
     explicit BoneChain(std::vector<Bone *> &joints) { joints_ = joints; }
 
+    /**
+     * Move every joint one Jacobian-transpose step towards the target.
+     *
+     * @return offset from the end effector to the target, before the step
+     */
     glm::vec3 Solve(glm::vec3 target, float velocity) {
+        TRACE_SCOPE("BoneChain::Solve");
+
         glm::vec3 end_diff = target - joints_.back()->GetEndPosition();
         if (glm::length(end_diff) > (velocity * 10000.0f)) {
             for (auto joint : joints_) {
@@ -20,6 +28,8 @@ public:
                 joint->Actuate(glm::vec3(delta_x, delta_y, delta_z));
             }
         }
+
+        return end_diff;
     }
 
 private:
@@ -0,0 +1,161 @@
+#ifndef MODELS_BOUNDS_H_
+#define MODELS_BOUNDS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_access.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BOUNDS_SSE
+#endif
+
+/**
+ * Axis-aligned bounding box, empty until a point is added.
+ */
+struct BoundingBox {
+    glm::vec3 min{INFINITY};
+    glm::vec3 max{-INFINITY};
+
+    [[nodiscard]] bool IsEmpty() const { return min.x > max.x; }
+
+    [[nodiscard]] glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+
+    [[nodiscard]] glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+    void Add(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Add(const BoundingBox &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    /**
+     * @return box around this box transformed, from its center and the absolute transform of its extents
+     */
+    [[nodiscard]] BoundingBox Transform(const glm::mat4 &transform) const {
+        if (IsEmpty()) {
+            return *this;
+        }
+
+        auto center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
+        auto extents = GetExtents();
+        auto world_extents = glm::abs(glm::vec3(transform[0])) * extents.x +
+                             glm::abs(glm::vec3(transform[1])) * extents.y +
+                             glm::abs(glm::vec3(transform[2])) * extents.z;
+
+        return BoundingBox{.min = center - world_extents, .max = center + world_extents};
+    }
+};
+
+/**
+ * Bounding sphere, in the space of the box it is computed with.
+ */
+struct BoundingSphere {
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+};
+
+enum FrustumTest {
+    FRUSTUM_OUTSIDE,    // outside of a plane, can be skipped with everything it contains
+    FRUSTUM_INTERSECTS, // possibly visible, contents need their own tests
+    FRUSTUM_INSIDE,     // inside all planes, contents need no tests
+};
+
+/**
+ * Six planes of a view frustum, tested four at a time.
+ *
+ * The planes are stored as structure of arrays, padded to eight with planes nothing is outside of, so a volume is
+ * classified against all of them with two rounds of SSE arithmetic (scalar on other targets).
+ */
+class Frustum {
+public:
+    /**
+     * @param view_projection projection times view matrix, planes are extracted in the space it transforms from
+     */
+    void Set(const glm::mat4 &view_projection) {
+        auto row = [&view_projection](int i) { return glm::row(view_projection, i); };
+
+        const glm::vec4 planes[6] = {
+            row(3) + row(0), // left
+            row(3) - row(0), // right
+            row(3) + row(1), // bottom
+            row(3) - row(1), // top
+            row(3) + row(2), // near
+            row(3) - row(2), // far
+        };
+
+        for (auto i = 0; i < 8; ++i) {
+            // padding planes are infinitely far, nothing is outside of them or intersects them
+            auto plane = i < 6 ? planes[i] / glm::length(glm::vec3(planes[i]))
+                               : glm::vec4(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::max());
+            normal_x_[i] = plane.x;
+            normal_y_[i] = plane.y;
+            normal_z_[i] = plane.z;
+            abs_normal_x_[i] = std::abs(plane.x);
+            abs_normal_y_[i] = std::abs(plane.y);
+            abs_normal_z_[i] = std::abs(plane.z);
+            distance_[i] = plane.w;
+        }
+    }
+
+    [[nodiscard]] FrustumTest Test(const BoundingBox &box) const {
+        return box.IsEmpty() ? FRUSTUM_OUTSIDE : Test(box.GetCenter(), box.GetExtents(), 0.0f);
+    }
+
+    [[nodiscard]] FrustumTest Test(const BoundingSphere &sphere) const {
+        return Test(sphere.center, glm::vec3(0.0f), sphere.radius);
+    }
+
+private:
+    alignas(16) float normal_x_[8]{}, normal_y_[8]{}, normal_z_[8]{};
+    alignas(16) float abs_normal_x_[8]{}, abs_normal_y_[8]{}, abs_normal_z_[8]{};
+    alignas(16) float distance_[8]{};
+
+    /**
+     * Classify the box with the given center and extents, grown by radius.
+     */
+    [[nodiscard]] FrustumTest Test(const glm::vec3 &center, const glm::vec3 &extents, float radius) const {
+        auto outside = false, intersects = false;
+
+#ifdef BOUNDS_SSE
+        auto center_x = _mm_set1_ps(center.x), center_y = _mm_set1_ps(center.y), center_z = _mm_set1_ps(center.z);
+        auto extent_x = _mm_set1_ps(extents.x), extent_y = _mm_set1_ps(extents.y), extent_z = _mm_set1_ps(extents.z);
+        auto radii = _mm_set1_ps(radius);
+
+        for (auto i = 0; i < 8; i += 4) {
+            // signed distance of the center, and how far the volume reaches along the normal
+            auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(normal_x_ + i), center_x),
+                                                  _mm_mul_ps(_mm_load_ps(normal_y_ + i), center_y)),
+                                       _mm_add_ps(_mm_mul_ps(_mm_load_ps(normal_z_ + i), center_z),
+                                                  _mm_load_ps(distance_ + i)));
+            auto reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(abs_normal_x_ + i), extent_x),
+                                               _mm_mul_ps(_mm_load_ps(abs_normal_y_ + i), extent_y)),
+                                    _mm_add_ps(_mm_mul_ps(_mm_load_ps(abs_normal_z_ + i), extent_z), radii));
+
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps())) != 0;
+            intersects |= _mm_movemask_ps(_mm_cmplt_ps(distance, reach)) != 0;
+        }
+#else
+        for (auto i = 0; i < 6; ++i) {
+            auto distance =
+                normal_x_[i] * center.x + normal_y_[i] * center.y + normal_z_[i] * center.z + distance_[i];
+            auto reach = abs_normal_x_[i] * extents.x + abs_normal_y_[i] * extents.y + abs_normal_z_[i] * extents.z +
+                         radius;
+
+            outside |= distance + reach < 0.0f;
+            intersects |= distance < reach;
+        }
+#endif
+
+        return outside ? FRUSTUM_OUTSIDE : intersects ? FRUSTUM_INTERSECTS : FRUSTUM_INSIDE;
+    }
+};
+
+#endif // MODELS_BOUNDS_H_
@@ -0,0 +1,164 @@
+#ifndef MODELS_LOD_CACHE_H_
+#define MODELS_LOD_CACHE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "../cache_file.h"
+#include "mesh_simplifier.h"
+
+#define LOD_CACHE_DIRECTORY "lod_cache" // default, relative to the working directory
+#define LOD_CACHE_MAGIC 0x43444f4cu     // "LODC"
+#define LOD_CACHE_VERSION 1
+
+/**
+ * Level of detail chains loaded from the cache or generated.
+ */
+struct LodCacheStats {
+    size_t hits = 0, misses = 0;
+};
+
+/**
+ * On-disk cache of generated level of detail chains.
+ *
+ * A chain is keyed by the positions and indices of the full-detail mesh and the parameters it was generated with, so
+ * editing a model or the generation settings misses the cache instead of loading levels of another mesh.
+ */
+class LodCache {
+public:
+    static LodCache &GetInstance() {
+        static LodCache instance;
+        return instance;
+    }
+
+    void SetDirectory(const std::filesystem::path &directory) { directory_.Set(directory); }
+
+    void Disable() { enabled_ = false; }
+
+    /**
+     * @param parameters generation settings, hashed as raw bytes
+     */
+    [[nodiscard]] static uint64_t GetKey(const std::vector<glm::vec3> &positions,
+                                         const std::vector<unsigned int> &indices,
+                                         const void *parameters,
+                                         size_t parameters_size) {
+        CacheKey key;
+        key.Add(positions.data(), positions.size() * sizeof(glm::vec3));
+        key.Add(indices.data(), indices.size() * sizeof(unsigned int));
+        key.Add(parameters, parameters_size);
+
+        return key.Get();
+    }
+
+    /**
+     * @param max_levels most levels a valid entry has
+     * @param levels set to the cached levels, coarsest last
+     * @return false if disabled or there is no valid entry
+     */
+    bool Load(uint64_t key, size_t n_vertices, size_t max_levels, std::vector<LodLevel> &levels) {
+        if (!enabled_) {
+            return false;
+        }
+
+        auto path = directory_.GetPath(key);
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            ++stats_.misses;
+            return false;
+        }
+
+        // sizes are checked against what is left of the file before allocating, a corrupt entry is a miss
+
+        std::error_code error;
+        auto remaining = std::filesystem::file_size(path, error);
+
+        EntryHeader header{};
+        auto valid = !error && remaining >= sizeof(header) && file.read((char *)&header, sizeof(header)) &&
+                     header.magic == LOD_CACHE_MAGIC && header.version == LOD_CACHE_VERSION && header.key == key &&
+                     header.n_levels <= max_levels;
+
+        remaining -= valid ? sizeof(header) : 0;
+        valid = valid && header.n_levels <= remaining / (sizeof(LodLevel::error) + sizeof(uint32_t));
+
+        levels.assign(valid ? header.n_levels : 0, LodLevel{});
+        for (auto &level : levels) {
+            uint32_t n_indices = 0;
+            valid = remaining >= sizeof(level.error) + sizeof(n_indices) &&
+                    file.read((char *)&level.error, sizeof(level.error)) &&
+                    file.read((char *)&n_indices, sizeof(n_indices));
+            remaining -= valid ? sizeof(level.error) + sizeof(n_indices) : 0;
+
+            valid = valid && n_indices % 3 == 0 && n_indices <= remaining / sizeof(unsigned int);
+            if (!valid) {
+                break;
+            }
+
+            level.indices.resize(n_indices);
+            valid = bool(file.read((char *)level.indices.data(), std::streamsize(n_indices * sizeof(unsigned int))));
+            remaining -= n_indices * sizeof(unsigned int);
+            for (size_t i = 0; valid && i < level.indices.size(); ++i) {
+                valid = level.indices[i] < n_vertices;
+            }
+            if (!valid) {
+                break;
+            }
+        }
+
+        if (!valid) {
+            std::cerr << "WARNING: Ignoring invalid LOD cache entry " << path << std::endl;
+            levels.clear();
+            ++stats_.misses;
+            return false;
+        }
+
+        ++stats_.hits;
+        return true;
+    }
+
+    void Store(uint64_t key, const std::vector<LodLevel> &levels) {
+        if (!enabled_) {
+            return;
+        }
+
+        EntryHeader header{
+            .magic = LOD_CACHE_MAGIC,
+            .version = LOD_CACHE_VERSION,
+            .key = key,
+            .n_levels = uint32_t(levels.size()),
+        };
+
+        directory_.Write(key, [&](std::ofstream &file) {
+            file.write((const char *)&header, sizeof(header));
+            for (const auto &level : levels) {
+                auto n_indices = uint32_t(level.indices.size());
+                file.write((const char *)&level.error, sizeof(level.error));
+                file.write((const char *)&n_indices, sizeof(n_indices));
+                file.write((const char *)level.indices.data(), std::streamsize(n_indices * sizeof(unsigned int)));
+            }
+        });
+    }
+
+    [[nodiscard]] const LodCacheStats &GetStats() const { return stats_; }
+
+private:
+    struct EntryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t n_levels;
+    };
+
+    CacheDirectory directory_{LOD_CACHE_DIRECTORY, "lod", "LOD cache"};
+    bool enabled_ = true;
+
+    LodCacheStats stats_;
+
+    LodCache() = default;
+};
+
+#endif // MODELS_LOD_CACHE_H_
@@ -4,38 +4,47 @@
 #include "assimp/mesh.h"
 #include "assimp/scene.h"
 #include "glm/glm.hpp"
+#include "glm/gtx/transform.hpp"
 
 #include <iostream>
 #include <vector>
 
+#include "../profiling/trace.h"
+#include "../readback.h"
 #include "../shaders/feedback_shader.h"
+#include "../shaders/material.h"
 #include "../shaders/shader.h"
 
+#include "bounds.h"
+#include "lod_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
 #include "textures.h"
+#include "vertex_format.h"
 
 using namespace std::placeholders;
 
 #define NOT_NAN(x) (std::fpclassify(x) != FP_NAN)
 
-const glm::vec3 kDefaultMeshNormal = glm::vec3(0.0f, 0.0f, 1.0f);
-const glm::vec2 kDefaultMeshUV = glm::vec2(0.0f, 0.0f);
-const glm::vec3 kDefaultMeshTangent = glm::vec3(1.0f, 0.0f, 0.0f);
-const glm::vec3 kDefaultMeshBitangent = glm::vec3(0.0f, 1.0f, 0.0f);
-
-struct MeshVertex {
-    [[maybe_unused]] glm::vec3 position;
-    [[maybe_unused]] glm::vec2 uv;
-    [[maybe_unused]] glm::vec3 normal;
-    [[maybe_unused]] glm::vec3 tangent;
-    [[maybe_unused]] glm::vec3 bitangent;
-
-    explicit MeshVertex(glm::vec3 position)
-        : position(position), uv(kDefaultMeshUV), normal(kDefaultMeshNormal), tangent(kDefaultMeshTangent),
-          bitangent(kDefaultMeshBitangent) {}
-};
+#define MESH_LOD_MAX_LEVELS 5       // including the full-detail level
+#define MESH_LOD_MIN_TRIANGLES 128  // levels are not simplified below this
+#define MESH_LOD_MIN_REDUCTION 0.9f // a level keeping more triangles of the previous one ends the chain
+#define MESH_LOD_MAX_ERROR 0.05f    // largest simplification error, as a fraction of the bounding radius
+
+// material texture slots are laid out by mesh texture role
+static_assert(MESH_TEXTURE_ROLE_HEIGHT - MESH_TEXTURE_ROLE_DIFFUSE + 1 == MATERIAL_TEXTURE_ROLES);
 
 class Mesh;
 
+/**
+ * Range of one level of detail in the element buffer.
+ */
+struct MeshLod {
+    size_t first; // index of the first element
+    size_t count; // elements
+    float error;  // distance to the full-detail surface, in model units
+};
+
 struct MeshVertexPickResult {
     float distance;
     const MeshVertex *vertex;
@@ -54,11 +63,21 @@ struct MeshVertexPickResultComparator {
 
 class Mesh {
 public:
-    Mesh(const aiMesh *mesh, const aiScene *scene, const std::string &base_path, TextureManager &manager) {
+    Mesh(const aiMesh *mesh, const aiScene *scene, const std::string &base_path, TextureManager &manager)
+        : layout_(GetDefaultLayout()) {
         LoadVertices(mesh);
         LoadMaterials(mesh, scene, base_path, manager);
+
+        if (GenerateLodsOnLoad() && triangles_) {
+            GenerateLods();
+        }
     }
 
+    /**
+     * Geometry-only mesh without materials, needs no OpenGL context until Initialize().
+     */
+    explicit Mesh(const aiMesh *mesh) : layout_(GetDefaultLayout()) { LoadVertices(mesh); }
+
     ~Mesh() {
         for (auto i : delta_positions_) {
             delete i;
@@ -66,108 +85,65 @@ public:
         delete[] tf_out_;
     }
 
-    void Draw(GLuint texture_unit, ShaderProgram *shader) const {
-        shader->SetVec3("meshAmbient", ambient_);
-        shader->SetVec3("meshDiffuse", diffuse_);
-        shader->SetVec3("meshSpecular", specular_);
-        shader->SetFloat("meshShininess", shininess_);
-
-        GLint n_diffuse = 0, n_specular = 0, n_normal = 0, n_height = 0, n_unknown = 0;
-        for (auto texture : textures_) {
-            std::string name;
-            switch (texture.role) {
-            case MESH_TEXTURE_ROLE_DIFFUSE:
-                name = "diffuseMap" + std::to_string(n_diffuse++);
-                break;
-            case MESH_TEXTURE_ROLE_SPECULAR:
-                name = "specularMap" + std::to_string(n_specular++);
-                break;
-            case MESH_TEXTURE_ROLE_NORMAL:
-                name = "normalMap" + std::to_string(n_normal++);
-                break;
-            case MESH_TEXTURE_ROLE_HEIGHT:
-                name = "heightMap" + std::to_string(n_height++);
-                break;
-            default:
-                name = "texture" + std::to_string(n_unknown++);
-                std::cerr << "WARN: Unknown texture role " << texture.role << std::endl;
-                break;
-            }
-
-            glActiveTexture(GL_TEXTURE0 + texture_unit);
-            glBindTexture(GL_TEXTURE_2D, texture.name);
-            shader->SetInt(name.c_str(), GLint(texture_unit));
+    /**
+     * @param lod level of detail, 0 for full detail
+     */
+    void Draw(ShaderProgram *shader, size_t lod = 0) const {
+        Bind(shader);
+        DrawBound(lod);
+    }
 
-            ++texture_unit;
+    /**
+     * Use the shader variant for this mesh and bind its material and vertex array, for setting per-draw uniforms
+     * before DrawBound().
+     */
+    void Bind(ShaderProgram *shader) const {
+        shader->UseVariant(GetShaderFeatures());
+        if (material_ != nullptr) {
+            MaterialLibrary::GetInstance().Bind(material_);
         }
 
-        shader->SetInt("nDiffuseMap", n_diffuse);
-        shader->SetInt("nSpecularMap", n_specular);
-        shader->SetInt("nNormalMap", n_normal);
-        shader->SetInt("nHeightMap", n_height);
+        GlStateCache::GetInstance().BindVertexArray(vao_);
+    }
 
-        glBindVertexArray(vao_);
-        glDrawElements(GL_TRIANGLES, GLsizei(indices_.size()), GL_UNSIGNED_INT, (const void *)nullptr);
-        glBindVertexArray(0);
+    /**
+     * Draw with the state bound by Bind().
+     *
+     * @param lod level of detail, 0 for full detail
+     */
+    void DrawBound(size_t lod = 0) const { DrawElements(lod); }
+
+    /**
+     * Draw positions only, for depth-only passes. Binds no material, the shader is expected to be in use.
+     *
+     * @param lod level of detail, the same as the shading pass draws so depths are equal
+     */
+    void DrawDepth(size_t lod = 0) const {
+        GlStateCache::GetInstance().BindVertexArray(depth_vao_);
+        DrawElements(lod);
     }
 
     void Initialize() {
         glGenVertexArrays(1, &vao_);
         glBindVertexArray(vao_);
 
-        // vertex buffer
+        // vertex buffer, encoded in the mesh's vertex layout
         glGenBuffers(1, &vbo_);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-        glBufferData(
-            GL_ARRAY_BUFFER, (GLsizeiptr)(vertices_.size() * sizeof(MeshVertex)), &vertices_[0], GL_STATIC_DRAW);
-
-        // bind position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)(offsetof(MeshVertex, position)));
-        glEnableVertexAttribArray(0);
-
-        // bind texture coordinate attribute
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)(offsetof(MeshVertex, uv)));
-        glEnableVertexAttribArray(1);
-
-        // bind normal attribute
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)(offsetof(MeshVertex, normal)));
-        glEnableVertexAttribArray(2);
-
-        // bind tangent attribute
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)(offsetof(MeshVertex, tangent)));
-        glEnableVertexAttribArray(3);
-
-        // bind bitangent attribute
-        glVertexAttribPointer(
-            4, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)(offsetof(MeshVertex, bitangent)));
-        glEnableVertexAttribArray(4);
+        UploadVertices();
+        layout_->set_attributes(false);
 
-        // element buffer
         glGenBuffers(1, &ebo_);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-        glBufferData(
-            GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indices_.size() * sizeof(GLuint)), &indices_[0], GL_STATIC_DRAW);
+        UploadIndices();
 
-        // delta-position buffer
-        glGenBuffers(1, &vbo_delta_);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_delta_);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertices_.size() * sizeof(glm::vec3)), nullptr, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid *)nullptr);
-        glEnableVertexAttribArray(5);
-
-        glCheckError();
-
-        // transform feedback: inputs
-        glGenVertexArrays(1, &tf_vao_);
-        glBindVertexArray(tf_vao_);
+        // depth-only vao: positions of the same vertex buffer, so picked vertex edits show in both
+        glGenVertexArrays(1, &depth_vao_);
+        glBindVertexArray(depth_vao_);
 
-        glGenBuffers(1, &tf_vbo_in_);
-        glBindBuffer(GL_ARRAY_BUFFER, tf_vbo_in_);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertices_.size() * sizeof(MeshVertex)), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        layout_->set_attributes(true);
 
-        glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)(offsetof(MeshVertex, position)));
-        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
 
         glCheckError();
 
@@ -175,49 +151,77 @@ public:
         glGenTransformFeedbacks(1, &tfo_);
         glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, tfo_);
 
-        glGenBuffers(1, &tf_vbo_out_);
-        glBindBuffer(GL_ARRAY_BUFFER, tf_vbo_out_);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertices_.size() * sizeof(GLfloat)), nullptr, GL_DYNAMIC_READ);
-
-        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, tf_vbo_out_);
-
-        glGenQueries(1, &tfq_);
-
-        tf_out_ = new GLfloat[vertices_.size()];
+        InitializeReadback();
 
         glCheckError();
+
+        // start compiling the shader variants this mesh draws with while the rest loads
+        ShaderProgram::PrepareFeatures(GetShaderFeatures());
     }
 
     void LoadDeltaMesh(const aiMesh *mesh) {
+        auto n_sources = source_remap_.empty() ? vertices_.size() : source_remap_.size();
+        if (n_sources != mesh->mNumVertices) {
+            std::cerr << "ERROR: delta mesh has different number of vertices" << std::endl;
+        } else if (!source_remap_.empty()) {
+            SplitWeldedVertices(mesh);
+        }
+
         delta_positions_.push_back(new std::vector<glm::vec3>());
         delta_weights_.push_back(0.0f);
 
         auto back = delta_positions_.back();
 
-        back->reserve(mesh->mNumVertices);
-
-        if (vertices_.size() != mesh->mNumVertices) {
-            std::cerr << "ERROR: delta mesh has different number of vertices" << std::endl;
+        // vertices may have been welded and reordered since loading, delta meshes are in the file's order
+        back->assign(vertices_.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i < vertices_.size(); ++i) {
+            auto source = source_indices_.empty() ? i : size_t(source_indices_[i]);
+            if (source < mesh->mNumVertices) {
+                (*back)[i] = vertices_[i].position - glm::vec3(mesh->mVertices[source].x,
+                                                               mesh->mVertices[source].y,
+                                                               mesh->mVertices[source].z);
+            }
         }
 
-        for (size_t i = 0; i < std::min(vertices_.size(), size_t(mesh->mNumVertices)); ++i) {
-            back->push_back(vertices_[i].position -
-                            glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+        // the delta mesh at full weight, so meshes are not culled while morphing towards it
+        for (size_t i = 0; i < vertices_.size(); ++i) {
+            GrowBounds(vertices_[i].position - (*back)[i]);
         }
     }
 
-    void Pick(MeshVertexPickResult &result, glm::mat4 model, Mesh *self) const {
+    /**
+     * Picks from the cursor distances captured READBACK_FRAMES - 1 frames ago, then captures the current ones.
+     */
+    void Pick(MeshVertexPickResult &result, glm::mat4 model, Mesh *self) {
+        TRACE_SCOPE("Mesh::Pick");
+
+        if (tf_out_ == nullptr) {
+            return; // readback failed to initialize
+        }
+
+        // consume an earlier frame's feedback, if the GPU has finished it
+
+        GLint vertices_count = 0;
+        if (tf_readback_.Read(tf_out_, &vertices_count)) {
+            if (vertices_count == vertices_.size()) {
+                PickFromDistances(result, model, self);
+            } else {
+                std::cerr << "ERROR: Transform feedback written " << vertices_count << " != " << vertices_.size()
+                          << std::endl;
+            }
+        }
+
         // draw for feedback
 
         glEnable(GL_RASTERIZER_DISCARD);
 
         glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, tfo_);
-        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, tf_vbo_out_);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, tf_readback_.GetWriteBuffer());
 
-        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, tfq_);
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, tf_readback_.GetWriteQuery());
         glBeginTransformFeedback(GL_POINTS);
 
-        glBindVertexArray(vao_);
+        GlStateCache::GetInstance().BindVertexArray(vao_);
         glDrawArrays(GL_POINTS, 0, GLsizei(vertices_.size()));
 
         glEndTransformFeedback();
@@ -225,49 +229,17 @@ public:
 
         glDisable(GL_RASTERIZER_DISCARD);
 
-        glCheckError();
-
-        // query feedback result
-
-        GLint vertices_count = 0;
-        glGetQueryObjectiv(tfq_, GL_QUERY_RESULT, &vertices_count);
-        if (vertices_count != vertices_.size()) {
-            std::cerr << "ERROR: Transform feedback written " << vertices_count << " != " << vertices_.size()
-                      << std::endl;
-            return;
-        }
+        tf_readback_.EndWrite();
 
         glCheckError();
-
-        glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, GLsizeiptr(sizeof(GLfloat) * vertices_count), tf_out_);
-
-        if (glCheckError() == GL_NO_ERROR) {
-            for (size_t i = 0; i < vertices_count; ++i) {
-                if (tf_out_[i] < result.distance) {
-                    result.distance = tf_out_[i];
-                    result.vertex = &vertices_[i];
-                    result.world_position = glm::vec3(model * glm::vec4(vertices_[i].position, 1.0f));
-
-                    auto index = i;
-                    result.update_position = [self, index](const glm::vec3 &position) {
-                        self->vertices_[index].position = position;
-
-                        // re-buffer vertices
-                        glBindVertexArray(self->vao_);
-                        glBindBuffer(GL_ARRAY_BUFFER, self->vbo_);
-                        glBufferData(GL_ARRAY_BUFFER,
-                                     (GLsizeiptr)(self->vertices_.size() * sizeof(MeshVertex)),
-                                     &self->vertices_[0],
-                                     GL_STATIC_DRAW);
-                    };
-                }
-            }
-        }
     }
 
     void SetDeltaWeight(size_t index, float weight) { delta_weights_[index] = weight; }
 
-    void UpdateDeltaWeights() {
+    /**
+     * Blend the weighted delta meshes into delta_weighted_, without uploading them.
+     */
+    void AccumulateDeltaWeights() {
         for (size_t i = 0; i < vertices_.size(); ++i) {
             delta_weighted_[i] = glm::vec3(0.0f);
         }
@@ -277,33 +249,397 @@ public:
                 delta_weighted_[vert_i] += delta_weights_[weight_i] * delta_positions_[weight_i]->at(vert_i);
             }
         }
+    }
 
-        glBindVertexArray(vao_);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_delta_);
-        glBufferData(
-            GL_ARRAY_BUFFER, (GLsizeiptr)(vertices_.size() * sizeof(glm::vec3)), &delta_weighted_[0], GL_STATIC_DRAW);
+    /**
+     * @return center of the bounding box of the vertices, in model space
+     */
+    [[nodiscard]] glm::vec3 GetCenter() const { return center_; }
+
+    /**
+     * @return largest distance of a vertex to GetCenter(), in model space
+     */
+    [[nodiscard]] float GetRadius() const { return radius_; }
+
+    /**
+     * @return bounding box of the vertices, in model space, grown by vertex edits and delta meshes
+     */
+    [[nodiscard]] const BoundingBox &GetBounds() const { return bounds_; }
+
+    /**
+     * @return levels of detail, the full-detail indices first and coarser ones after them
+     */
+    [[nodiscard]] const std::vector<MeshLod> &GetLods() const { return lods_; }
+
+    /**
+     * @param before cache statistics of the indices as loaded are added to it
+     * @param after cache statistics of the indices as drawn are added to it
+     */
+    void GetCacheStatistics(VertexCacheStatistics &before, VertexCacheStatistics &after) const {
+        before += cache_before_;
+        after += cache_after_;
+    }
+
+    /**
+     * Weld identical vertices of meshes created from now on and reorder them for the vertex caches, on by default.
+     */
+    static void SetOptimizeOnLoad(bool optimize) { OptimizeOnLoad() = optimize; }
+
+    /**
+     * Simplify meshes created from now on into levels of detail, on by default. Geometry-only meshes have none.
+     */
+    static void SetGenerateLods(bool generate) { GenerateLodsOnLoad() = generate; }
+
+    /**
+     * Vertex layout of meshes created from now on.
+     */
+    static void SetDefaultLayout(const VertexLayout *layout) {
+        DefaultLayout() = layout;
+        ShaderProgram::SetDefaultFeatures(layout->shader_features);
+    }
+
+    static const VertexLayout *GetDefaultLayout() { return DefaultLayout(); }
+
+    [[nodiscard]] const VertexLayout *GetLayout() const { return layout_; }
+
+    /**
+     * @return transform from the encoded positions to model space, identity unless positions are quantized
+     */
+    [[nodiscard]] const glm::mat4 &GetPositionTransform() const { return position_transform_; }
+
+    /**
+     * @return SHADER_FEATURE_* flags of the material and the vertex layout
+     */
+    [[nodiscard]] uint32_t GetShaderFeatures() const {
+        return (material_ != nullptr ? material_->shader_features : 0) | layout_->shader_features;
+    }
+
+    [[nodiscard]] const std::vector<glm::vec3> &GetDeltaWeighted() const { return delta_weighted_; }
+
+    /**
+     * @return shared material, nullptr for geometry-only meshes
+     */
+    [[nodiscard]] const Material *GetMaterial() const { return material_; }
+
+    /**
+     * @return index of the first smallest value, n_values if there are none
+     */
+    static size_t FindMinimum(const GLfloat *values, size_t n_values) {
+        size_t minimum = n_values;
+        for (size_t i = 0; i < n_values; ++i) {
+            if (minimum == n_values || values[i] < values[minimum]) {
+                minimum = i;
+            }
+        }
+        return minimum;
+    }
+
+    void UpdateDeltaWeights() {
+        TRACE_SCOPE("Mesh::UpdateDeltaWeights");
+
+        AccumulateDeltaWeights();
+        for (size_t i = 0; i < vertices_.size(); ++i) {
+            GrowBounds(vertices_[i].position - delta_weighted_[i]); // weights can add up or exceed 1
+        }
+        UploadDeltas();
     }
 
 private:
     std::vector<MeshVertex> vertices_;
     std::vector<unsigned int> indices_;
-    std::vector<MeshTexture> textures_;
+    std::vector<unsigned int> lod_indices_;    // coarser levels of detail, uploaded after indices_
+    std::vector<MeshLod> lods_;                // full detail first
+    bool triangles_ = true;                    // all faces are triangles
+    std::vector<unsigned int> source_indices_; // first aiMesh vertex of every vertex, empty if none were moved
+    std::vector<unsigned int> source_remap_;   // vertex of every aiMesh vertex, empty if none were moved
+    GLenum index_type_ = GL_UNSIGNED_INT;      // of ebo_
+    const VertexLayout *layout_;         // encoding of vertices_ in vbo_
+    VertexQuantization quantization_;    // bounds of the encoded positions, if the layout quantizes them
+    glm::mat4 position_transform_{1.0f}; // applies quantization_, folded into the model matrix
+    const Material *material_ = nullptr; // shared with meshes of equal materials, nullptr for geometry-only meshes
+    BoundingBox bounds_;                 // of the vertices as loaded, edited and morphed since
+    glm::vec3 center_{0.0f};             // bounding box center as loaded, sorts draws by depth
+    float radius_ = 0.0f;                // bounding sphere radius around center_, culls and scales the LOD errors
 
     std::vector<glm::vec3> delta_weighted_;
 
     std::vector<std::vector<glm::vec3> *> delta_positions_;
     std::vector<float> delta_weights_;
 
-    glm::vec3 ambient_ = glm::vec3(0, 0, 0);
-    glm::vec3 diffuse_ = glm::vec3(0, 0, 0);
-    glm::vec3 specular_ = glm::vec3(0, 0, 0);
-    float shininess_ = 0;
+    GLuint vao_ = 0, vbo_ = 0, ebo_ = 0;
+    GLuint vbo_delta_ = 0; // created by the first UpdateDeltaWeights(), only blendshape meshes need it
+    GLuint depth_vao_ = 0; // position attribute only
+
+    GLuint tfo_ = 0;            // transform feedback object
+    ReadbackRing tf_readback_;  // output buffers, one per frame in flight
+    GLfloat *tf_out_ = nullptr; // result copy-back buffer, null if picking is disabled
 
-    GLuint vao_ = 0, vbo_ = 0, ebo_ = 0, vbo_delta_ = 0;
+    VertexCacheStatistics cache_before_, cache_after_;
+
+    static bool &OptimizeOnLoad() {
+        static bool optimize = true;
+        return optimize;
+    }
+
+    static bool &GenerateLodsOnLoad() {
+        static bool generate = true;
+        return generate;
+    }
+
+    static const VertexLayout *&DefaultLayout() {
+        static_assert(PackedVertexFormat::kShaderFeatures == SHADER_FEATURE_PACKED_NORMALS,
+                      "shader programs start compiling the variant of the default layout's features");
+        static const VertexLayout *layout = FindVertexLayout("packed");
+        return layout;
+    }
 
-    GLuint tfo_ = 0, tfq_ = 0;                           // transform feedback object, query
-    GLuint tf_vao_ = 0, tf_vbo_in_ = 0, tf_vbo_out_ = 0; // input vao, input vbo, output vbo
-    GLfloat *tf_out_;                                    // result copy-back buffer
+    void DrawElements(size_t lod) const {
+        const auto &range = lods_[std::min(lod, lods_.size() - 1)];
+        auto index_size = index_type_ == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        glDrawElements(GL_TRIANGLES, GLsizei(range.count), index_type_, (const void *)(range.first * index_size));
+    }
+
+    /**
+     * Encode the vertices into vbo_, fitting the quantization bounds to them first if the layout quantizes positions.
+     */
+    void UploadVertices() {
+        if (layout_->quantizes_positions && !vertices_.empty()) {
+            auto min = vertices_[0].position, max = vertices_[0].position;
+            for (const auto &vertex : vertices_) {
+                min = glm::min(min, vertex.position);
+                max = glm::max(max, vertex.position);
+            }
+
+            quantization_.min = min;
+            quantization_.extent = max - min;
+            for (auto axis = 0; axis < 3; ++axis) {
+                if (quantization_.extent[axis] == 0.0f) {
+                    quantization_.extent[axis] = 1.0f; // flat along the axis, keep the transform invertible
+                }
+            }
+            position_transform_ = glm::translate(quantization_.min) * glm::scale(quantization_.extent);
+        }
+
+        std::vector<uint8_t> data(vertices_.size() * layout_->stride);
+        layout_->encode(vertices_.data(), vertices_.size(), quantization_, data.data());
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)data.size(), data.data(), GL_STATIC_DRAW);
+    }
+
+    /**
+     * Re-encode one edited vertex into vbo_, or all of them if it left the quantization bounds.
+     */
+    void UploadVertex(size_t index) {
+        GrowBounds(vertices_[index].position);
+
+        if (layout_->quantizes_positions) {
+            auto fraction = (vertices_[index].position - quantization_.min) / quantization_.extent;
+            if (glm::any(glm::lessThan(fraction, glm::vec3(0.0f))) ||
+                glm::any(glm::greaterThan(fraction, glm::vec3(1.0f)))) {
+                UploadVertices();
+                if (vbo_delta_ != 0) {
+                    UploadDeltas(); // in units of the new bounds
+                }
+                return;
+            }
+        }
+
+        std::vector<uint8_t> data(layout_->stride);
+        layout_->encode(&vertices_[index], 1, quantization_, data.data());
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        glBufferSubData(GL_ARRAY_BUFFER, GLintptr(index * layout_->stride), GLsizeiptr(data.size()), data.data());
+    }
+
+    /**
+     * Upload delta_weighted_ into vbo_delta_, in units of the encoded positions.
+     */
+    void UploadDeltas() {
+        if (vbo_delta_ == 0) {
+            glGenBuffers(1, &vbo_delta_);
+
+            GlStateCache::GetInstance().BindVertexArray(vao_);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo_delta_);
+            glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid *)nullptr);
+            glEnableVertexAttribArray(5);
+        }
+
+        const auto *deltas = delta_weighted_.data();
+
+        std::vector<glm::vec3> scaled;
+        if (layout_->quantizes_positions) {
+            scaled.reserve(delta_weighted_.size());
+            for (const auto &delta : delta_weighted_) {
+                scaled.push_back(delta / quantization_.extent);
+            }
+            deltas = scaled.data();
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_delta_);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertices_.size() * sizeof(glm::vec3)), deltas, GL_STATIC_DRAW);
+    }
+
+    /**
+     * Grow the bounding box and sphere to contain a position, the center stays.
+     */
+    void GrowBounds(const glm::vec3 &position) {
+        bounds_.Add(position);
+        radius_ = std::max(radius_, glm::distance(position, center_));
+    }
+
+    /**
+     * Encode indices_ and lod_indices_ into ebo_, 16-bit if all vertices can be addressed with it. The element buffer
+     * must be bound.
+     */
+    void UploadIndices() {
+        std::vector<GLuint> indices(indices_);
+        indices.insert(indices.end(), lod_indices_.begin(), lod_indices_.end());
+
+        if (vertices_.size() < 65536) {
+            std::vector<GLushort> short_indices(indices.begin(), indices.end());
+            index_type_ = GL_UNSIGNED_SHORT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         (GLsizeiptr)(short_indices.size() * sizeof(GLushort)),
+                         short_indices.data(),
+                         GL_STATIC_DRAW);
+        } else {
+            index_type_ = GL_UNSIGNED_INT;
+            glBufferData(
+                GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indices.size() * sizeof(GLuint)), indices.data(), GL_STATIC_DRAW);
+        }
+    }
+
+    /**
+     * Create the readback ring and copy-back buffer for the current vertices, or disable picking if that fails.
+     */
+    void InitializeReadback() {
+        if (tf_readback_.Initialize((GLsizeiptr)(vertices_.size() * sizeof(GLfloat)))) {
+            tf_out_ = new GLfloat[vertices_.size()];
+        } else {
+            std::cerr << "ERROR: Failed to create readback buffers, picking disabled for this mesh" << std::endl;
+            tf_readback_.Destroy();
+        }
+    }
+
+    /**
+     * Weld the vertices again from the faces of a delta mesh, keeping apart those welded at load that the delta mesh
+     * moves to different positions, e.g. the corners of closed lips. Vertices welded together share all attributes
+     * and earlier deltas, so only the new delta positions can tell them apart.
+     */
+    void SplitWeldedVertices(const aiMesh *mesh) {
+        TRACE_SCOPE("Mesh::SplitWeldedVertices");
+
+        auto diverges = [this, mesh](size_t source) {
+            auto first = source_indices_[source_remap_[source]];
+            return mesh->mVertices[first] != mesh->mVertices[source];
+        };
+
+        size_t n_sources = source_remap_.size();
+        size_t source = 0;
+        while (source < n_sources && !diverges(source)) {
+            ++source;
+        }
+        if (source == n_sources) {
+            return; // the welding holds for this delta mesh
+        }
+
+        auto previous_remap = source_remap_;
+        auto n_previous = vertices_.size();
+
+        // one vertex per welded vertex and delta position, in the order of their first source, like WeldVertices()
+
+        std::vector<MeshVertex> vertices;
+        std::vector<unsigned int> sources;
+        std::vector<std::vector<unsigned int>> splits(n_previous); // new vertices of every welded vertex
+        for (source = 0; source < n_sources; ++source) {
+            auto &split = splits[previous_remap[source]];
+            auto it = std::find_if(split.begin(), split.end(), [&](unsigned int vertex) {
+                return mesh->mVertices[sources[vertex]] == mesh->mVertices[source];
+            });
+
+            if (it == split.end()) {
+                split.push_back(unsigned(vertices.size()));
+                vertices.push_back(vertices_[previous_remap[source]]);
+                sources.push_back(unsigned(source));
+                it = split.end() - 1;
+            }
+            source_remap_[source] = *it;
+        }
+
+        indices_.clear();
+        for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+            for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; ++j) {
+                indices_.push_back(source_remap_[mesh->mFaces[i].mIndices[j]]);
+            }
+        }
+
+        vertices_.swap(vertices);
+        source_indices_.swap(sources);
+        if (triangles_) {
+            OptimizeIndices();
+        }
+        cache_after_ = AnalyzeVertexCache(indices_, vertices_.size());
+
+        std::cout << "INFO: Split " << n_previous << " welded vertices into " << vertices_.size()
+                  << " for a delta mesh" << std::endl;
+
+        // earlier delta meshes, through the welded vertex of the first source of every vertex
+
+        for (auto deltas : delta_positions_) {
+            std::vector<glm::vec3> split_deltas(vertices_.size());
+            for (size_t i = 0; i < vertices_.size(); ++i) {
+                split_deltas[i] = (*deltas)[previous_remap[source_indices_[i]]];
+            }
+            deltas->swap(split_deltas);
+        }
+        delta_weighted_.assign(vertices_.size(), glm::vec3(0.0f));
+
+        // coarser levels index the previous vertices, simplify again
+
+        auto has_lods = lods_.size() > 1;
+        lods_.clear();
+        lod_indices_.clear();
+        lods_.push_back(MeshLod{.first = 0, .count = indices_.size(), .error = 0.0f});
+        if (has_lods) {
+            GenerateLods();
+        }
+
+        if (vao_ != 0) {
+            glBindVertexArray(vao_);
+            UploadVertices();
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+            UploadIndices();
+
+            tf_readback_.Destroy();
+            delete[] tf_out_;
+            tf_out_ = nullptr;
+            InitializeReadback();
+
+            if (vbo_delta_ != 0) {
+                AccumulateDeltaWeights();
+                UploadDeltas();
+            }
+
+            glCheckError();
+        }
+    }
+
+    void PickFromDistances(MeshVertexPickResult &result, glm::mat4 model, Mesh *self) const {
+        auto index = FindMinimum(tf_out_, vertices_.size());
+        if (index == vertices_.size() || !(tf_out_[index] < result.distance)) {
+            return;
+        }
+
+        result.distance = tf_out_[index];
+        result.vertex = &vertices_[index];
+        result.world_position = glm::vec3(model * glm::vec4(vertices_[index].position, 1.0f));
+
+        result.update_position = [self, index](const glm::vec3 &position) {
+            self->vertices_[index].position = position;
+            self->UploadVertex(index);
+        };
+    }
 
     void LoadMaterials(const aiMesh *mesh,
                        const aiScene *scene,
@@ -317,38 +653,71 @@ private:
         material->Get(AI_MATKEY_COLOR_SPECULAR, specular);
         material->Get(AI_MATKEY_SHININESS, shininess);
 
-        ambient_ = glm::vec3(ambient.r, ambient.g, ambient.b);
-        diffuse_ = glm::vec3(diffuse.r, diffuse.g, diffuse.b);
-        specular_ = glm::vec3(specular.r, specular.g, specular.b);
-        shininess_ = shininess.r;
+        Material layout;
+        layout.uniforms = MaterialUniforms{
+            .ambient = glm::vec4(ambient.r, ambient.g, ambient.b, 0.0f),
+            .diffuse = glm::vec4(diffuse.r, diffuse.g, diffuse.b, 0.0f),
+            .specular = glm::vec3(specular.r, specular.g, specular.b),
+            .shininess = shininess.r,
+        };
 
-        LoadTexture(material, aiTextureType_DIFFUSE, MESH_TEXTURE_ROLE_DIFFUSE, base_path, manager);
-        LoadTexture(material, aiTextureType_SPECULAR, MESH_TEXTURE_ROLE_SPECULAR, base_path, manager);
-        LoadTexture(material, aiTextureType_NORMALS, MESH_TEXTURE_ROLE_NORMAL, base_path, manager);
-        LoadTexture(material, aiTextureType_HEIGHT, MESH_TEXTURE_ROLE_HEIGHT, base_path, manager);
+        LoadTexture(material, aiTextureType_DIFFUSE, MESH_TEXTURE_ROLE_DIFFUSE, base_path, manager, layout);
+        LoadTexture(material, aiTextureType_SPECULAR, MESH_TEXTURE_ROLE_SPECULAR, base_path, manager, layout);
+        LoadTexture(material, aiTextureType_NORMALS, MESH_TEXTURE_ROLE_NORMAL, base_path, manager, layout);
+        LoadTexture(material, aiTextureType_HEIGHT, MESH_TEXTURE_ROLE_HEIGHT, base_path, manager, layout);
 
-        if (textures_.empty()) {
+        if (layout.n_texture_slots == 0) {
             std::cerr << "WARNING: Mesh has no textures" << std::endl;
         }
+
+        material_ = MaterialLibrary::GetInstance().GetShared(layout);
     }
 
     void LoadTexture(const aiMaterial *material,
                      aiTextureType type,
                      MeshTextureRole role,
                      const std::filesystem::path &base_path,
-                     TextureManager &manager) {
+                     TextureManager &manager,
+                     Material &layout) {
         // TODO: resolve relative path with model file path
 
-        for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
+        auto n_textures = material->GetTextureCount(type);
+        if (n_textures > MATERIAL_TEXTURES_PER_ROLE) {
+            std::cerr << "WARNING: Mesh has " << n_textures << " textures of role " << role << ", only "
+                      << MATERIAL_TEXTURES_PER_ROLE << " are bound" << std::endl;
+            n_textures = MATERIAL_TEXTURES_PER_ROLE;
+        }
+
+        for (unsigned int i = 0; i < n_textures; i++) {
             aiString aiPath;
             material->GetTexture(type, i, &aiPath);
 
             auto path = std::string(aiPath.C_Str());
-            textures_.emplace_back(manager.LoadTexture2D(role, path, base_path));
+            auto slot = (role - MESH_TEXTURE_ROLE_DIFFUSE) * MATERIAL_TEXTURES_PER_ROLE + i;
+            layout.textures[slot] = manager.LoadTexture2D(role, path, base_path).name;
+            layout.n_texture_slots = std::max(layout.n_texture_slots, GLsizei(slot + 1));
+            layout.shader_features |= GetShaderFeature(role);
+        }
+    }
+
+    static uint32_t GetShaderFeature(MeshTextureRole role) {
+        switch (role) {
+        case MESH_TEXTURE_ROLE_DIFFUSE:
+            return SHADER_FEATURE_DIFFUSE_MAP;
+        case MESH_TEXTURE_ROLE_SPECULAR:
+            return SHADER_FEATURE_SPECULAR_MAP;
+        case MESH_TEXTURE_ROLE_NORMAL:
+            return SHADER_FEATURE_NORMAL_MAP;
+        case MESH_TEXTURE_ROLE_HEIGHT:
+            return SHADER_FEATURE_HEIGHT_MAP;
+        default:
+            return 0;
         }
     }
 
     void LoadVertices(const aiMesh *mesh) {
+        TRACE_SCOPE("Mesh::LoadVertices");
+
         vertices_.reserve(mesh->mNumVertices); // optimization: pre-allocate memory for insertions
 
         for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
@@ -392,9 +761,15 @@ private:
             }
         }
 
-        delta_weighted_.reserve(vertices_.size());
-        for (unsigned int i = 0; i < vertices_.size(); ++i) {
-            delta_weighted_[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+        for (const auto &vertex : vertices_) {
+            bounds_.Add(vertex.position);
+        }
+
+        if (!bounds_.IsEmpty()) {
+            center_ = bounds_.GetCenter();
+            for (const auto &vertex : vertices_) {
+                radius_ = std::max(radius_, glm::distance(vertex.position, center_));
+            }
         }
 
         // load face indices
@@ -408,8 +783,112 @@ private:
             for (int j = 0; j < mesh->mFaces[i].mNumIndices; j++) {
                 indices_.push_back(mesh->mFaces[i].mIndices[j]);
             }
+            triangles_ &= mesh->mFaces[i].mNumIndices == 3;
         }
+
+        cache_before_ = AnalyzeVertexCache(indices_, vertices_.size());
+        if (OptimizeOnLoad()) {
+            {
+                TRACE_SCOPE("Mesh::WeldVertices");
+                source_indices_ = WeldVertices(vertices_, indices_, source_remap_);
+            }
+
+            if (triangles_) {
+                OptimizeIndices();
+            }
+        }
+        cache_after_ = AnalyzeVertexCache(indices_, vertices_.size());
+
+        delta_weighted_.assign(vertices_.size(), glm::vec3(0.0f, 0.0f, 0.0f));
+
+        lods_.push_back(MeshLod{.first = 0, .count = indices_.size(), .error = 0.0f});
     };
+
+    /**
+     * Simplify the triangles into coarser levels of detail, each about half of the previous one, or load them from
+     * the cache. The levels index the same vertices, so picking and blendshapes apply to all of them.
+     */
+    void GenerateLods() {
+        TRACE_SCOPE("Mesh::GenerateLods");
+
+        std::vector<glm::vec3> positions;
+        positions.reserve(vertices_.size());
+        for (const auto &vertex : vertices_) {
+            positions.push_back(vertex.position);
+        }
+
+        const float parameters[] = {MESH_LOD_MAX_LEVELS,
+                                    MESH_LOD_MIN_TRIANGLES,
+                                    MESH_LOD_MIN_REDUCTION,
+                                    MESH_LOD_MAX_ERROR,
+                                    MESH_OPTIMIZER_CACHE_SIZE};
+        auto key = LodCache::GetKey(positions, indices_, parameters, sizeof(parameters));
+
+        std::vector<LodLevel> levels;
+        if (!LodCache::GetInstance().Load(key, vertices_.size(), MESH_LOD_MAX_LEVELS - 1, levels)) {
+            MeshSimplifier simplifier(indices_, positions);
+
+            auto n_triangles = indices_.size() / 3;
+            while (levels.size() + 1 < MESH_LOD_MAX_LEVELS && n_triangles / 2 >= MESH_LOD_MIN_TRIANGLES) {
+                const auto &indices = simplifier.Simplify(n_triangles / 2, MESH_LOD_MAX_ERROR * radius_);
+                if (float(indices.size() / 3) > float(n_triangles) * MESH_LOD_MIN_REDUCTION) {
+                    break; // locked or over the error bound
+                }
+
+                n_triangles = indices.size() / 3;
+                levels.push_back(LodLevel{.indices = indices, .error = simplifier.GetError()});
+
+                std::vector<size_t> clusters;
+                OptimizeVertexCache(levels.back().indices, vertices_.size(), clusters);
+            }
+
+            LodCache::GetInstance().Store(key, levels);
+        }
+
+        for (const auto &level : levels) {
+            lods_.push_back(MeshLod{
+                .first = indices_.size() + lod_indices_.size(),
+                .count = level.indices.size(),
+                .error = level.error,
+            });
+            lod_indices_.insert(lod_indices_.end(), level.indices.begin(), level.indices.end());
+        }
+    }
+
+    /**
+     * Reorder the triangles for the post-transform cache and less overdraw, then the vertices in fetch order.
+     */
+    void OptimizeIndices() {
+        TRACE_SCOPE("Mesh::OptimizeIndices");
+
+        std::vector<size_t> clusters;
+        OptimizeVertexCache(indices_, vertices_.size(), clusters);
+        OptimizeOverdraw(indices_, vertices_, clusters);
+
+        auto fetch_order = OptimizeVertexFetch(indices_, vertices_.size());
+
+        std::vector<MeshVertex> vertices;
+        std::vector<unsigned int> remap(vertices_.size()), sources;
+        vertices.reserve(vertices_.size());
+        sources.reserve(vertices_.size());
+        for (unsigned int i = 0; i < fetch_order.size(); ++i) {
+            auto previous = fetch_order[i];
+            vertices.push_back(vertices_[previous]);
+            sources.push_back(source_indices_.empty() ? previous : source_indices_[previous]);
+            remap[previous] = i;
+        }
+
+        if (source_remap_.empty()) {
+            source_remap_.swap(remap);
+        } else {
+            for (auto &index : source_remap_) {
+                index = remap[index];
+            }
+        }
+
+        vertices_.swap(vertices);
+        source_indices_.swap(sources);
+    }
 };
 
 #endif // MODELS_MESH_H_
@@ -0,0 +1,353 @@
+#ifndef MODELS_MESH_OPTIMIZER_H_
+#define MODELS_MESH_OPTIMIZER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "vertex_format.h"
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16            // FIFO post-transform cache entries, optimized for and reported
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f // clusters split once their ACMR is this close to the mesh's
+
+/**
+ * Merge vertices with bitwise identical attributes: files that index attributes separately, like OBJ, import with one
+ * vertex per face corner. Welded vertices keep the order of their first source vertex.
+ *
+ * @param remap set to the welded vertex of every source vertex
+ * @return for every welded vertex, the first source vertex merged into it
+ */
+inline std::vector<unsigned int> WeldVertices(std::vector<MeshVertex> &vertices,
+                                              std::vector<unsigned int> &indices,
+                                              std::vector<unsigned int> &remap) {
+    static_assert(sizeof(MeshVertex) % sizeof(uint32_t) == 0);
+    const auto kEmpty = ~0u;
+
+    auto hash = [](const MeshVertex &vertex) {
+        uint32_t words[sizeof(MeshVertex) / sizeof(uint32_t)];
+        std::memcpy(words, &vertex, sizeof(words));
+
+        uint64_t h = 14695981039346656037ull; // FNV-1a over words, then MurmurHash3's finalizer for the low bits
+        for (auto word : words) {
+            h = (h ^ word) * 1099511628211ull;
+        }
+        h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdull;
+        h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ull;
+        return h ^ (h >> 33);
+    };
+
+    size_t table_size = 1;
+    while (table_size < vertices.size() * 2) {
+        table_size *= 2;
+    }
+    std::vector<unsigned int> table(table_size, kEmpty); // welded vertex, open addressing with linear probing
+
+    std::vector<unsigned int> sources;
+    std::vector<MeshVertex> welded;
+    welded.reserve(vertices.size());
+    remap.resize(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        auto slot = hash(vertices[i]) & (table_size - 1);
+        while (table[slot] != kEmpty && std::memcmp(&welded[table[slot]], &vertices[i], sizeof(MeshVertex)) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (table[slot] == kEmpty) {
+            table[slot] = unsigned(welded.size());
+            welded.push_back(vertices[i]);
+            sources.push_back(unsigned(i));
+        }
+        remap[i] = table[slot];
+    }
+
+    for (auto &index : indices) {
+        index = remap[index];
+    }
+
+    vertices.swap(welded);
+    return sources;
+}
+
+/**
+ * Post-transform cache misses of an index buffer, simulated with a MESH_OPTIMIZER_CACHE_SIZE-entry FIFO cache.
+ */
+struct VertexCacheStatistics {
+    size_t n_triangles = 0;
+    size_t n_vertices = 0;
+    size_t n_misses = 0; // vertices transformed
+
+    /**
+     * @return average cache miss ratio, transformed vertices per triangle (0.5 at best, 3 at worst)
+     */
+    [[nodiscard]] float GetAcmr() const { return n_triangles == 0 ? 0.0f : float(n_misses) / float(n_triangles); }
+
+    /**
+     * @return average transform to vertex ratio, transformed vertices per vertex (1 at best)
+     */
+    [[nodiscard]] float GetAtvr() const { return n_vertices == 0 ? 0.0f : float(n_misses) / float(n_vertices); }
+
+    VertexCacheStatistics &operator+=(const VertexCacheStatistics &other) {
+        n_triangles += other.n_triangles;
+        n_vertices += other.n_vertices;
+        n_misses += other.n_misses;
+        return *this;
+    }
+};
+
+inline VertexCacheStatistics AnalyzeVertexCache(const std::vector<unsigned int> &indices, size_t n_vertices) {
+    VertexCacheStatistics statistics{.n_triangles = indices.size() / 3, .n_vertices = n_vertices};
+
+    // a vertex is cached while fewer than MESH_OPTIMIZER_CACHE_SIZE misses happened after its own
+    std::vector<size_t> miss_times(n_vertices, 0);
+    for (auto index : indices) {
+        if (miss_times[index] == 0 || statistics.n_misses - miss_times[index] >= MESH_OPTIMIZER_CACHE_SIZE) {
+            miss_times[index] = ++statistics.n_misses;
+        }
+    }
+
+    return statistics;
+}
+
+/**
+ * Reorder triangles for the post-transform cache with Tipsify (Sander, Nehab & Barczak, "Fast Triangle Reordering for
+ * Vertex Locality and Reduced Overdraw", 2007): fan around a vertex that is still cached, prefer those whose remaining
+ * triangles will still hit, and fall back to recently used vertices at dead-ends.
+ *
+ * @param clusters set to the first triangle of every run that started at a dead-end
+ */
+inline void OptimizeVertexCache(std::vector<unsigned int> &indices,
+                                size_t n_vertices,
+                                std::vector<size_t> &clusters) {
+    auto n_triangles = indices.size() / 3;
+    const int cache_size = MESH_OPTIMIZER_CACHE_SIZE;
+
+    // triangles of every vertex, in CSR form
+    std::vector<unsigned int> offsets(n_vertices + 1, 0);
+    for (auto index : indices) {
+        ++offsets[index + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<unsigned int> live(n_vertices), adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            adjacency[fill[indices[i]]++] = unsigned(i / 3);
+        }
+        for (size_t v = 0; v < n_vertices; ++v) {
+            live[v] = offsets[v + 1] - offsets[v];
+        }
+    }
+
+    std::vector<int> cache_times(n_vertices, 0);
+    std::vector<unsigned int> dead_ends, candidates;
+    std::vector<bool> emitted(n_triangles, false);
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    clusters.clear();
+
+    int time = cache_size + 1;
+    size_t cursor = 0;
+    long fanning = n_vertices > 0 ? 0 : -1;
+    auto dead_end = true;
+
+    while (fanning >= 0) {
+        if (dead_end && (clusters.empty() || clusters.back() != output.size() / 3)) {
+            clusters.push_back(output.size() / 3);
+        }
+
+        candidates.clear();
+        for (auto a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+            auto triangle = adjacency[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+
+            for (auto k = 0; k < 3; ++k) {
+                auto v = indices[triangle * 3 + k];
+                output.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cache_times[v] > cache_size) {
+                    cache_times[v] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // next fanning vertex: the cached candidate that stays cached longest while its triangles are emitted
+        fanning = -1;
+        auto best_priority = -1;
+        for (auto v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+
+            auto priority = 0;
+            if (time - cache_times[v] + 2 * int(live[v]) <= cache_size) {
+                priority = time - cache_times[v];
+            }
+            if (priority > best_priority) {
+                fanning = v;
+                best_priority = priority;
+            }
+        }
+
+        dead_end = fanning < 0;
+        while (fanning < 0 && !dead_ends.empty()) {
+            auto v = dead_ends.back();
+            dead_ends.pop_back();
+            if (live[v] > 0) {
+                fanning = v;
+            }
+        }
+        while (fanning < 0 && cursor < n_vertices) {
+            if (live[cursor] > 0) {
+                fanning = long(cursor);
+            }
+            ++cursor;
+        }
+    }
+
+    indices.swap(output);
+}
+
+/**
+ * Reorder the clusters of a cache-optimized index buffer so that triangles facing away from the mesh center, which
+ * tend to occlude the others from most views, are drawn first. Clusters are split further where the cache already
+ * warmed up, so the order is not limited to the few dead-ends of a connected mesh.
+ *
+ * @param clusters first triangle of every cluster, as from OptimizeVertexCache()
+ */
+inline void OptimizeOverdraw(std::vector<unsigned int> &indices,
+                             const std::vector<MeshVertex> &vertices,
+                             const std::vector<size_t> &clusters) {
+    auto n_triangles = indices.size() / 3;
+    if (n_triangles == 0) {
+        return;
+    }
+
+    auto threshold = AnalyzeVertexCache(indices, vertices.size()).GetAcmr() * MESH_OPTIMIZER_OVERDRAW_THRESHOLD;
+
+    // split every cluster where its own ACMR, from a cold cache, drops below the threshold
+    std::vector<size_t> starts;
+    {
+        std::vector<size_t> miss_times(vertices.size(), 0);
+        size_t n_misses = 0, cluster_misses = 0, cluster_start = 0;
+
+        auto next_cluster = clusters.begin();
+        for (size_t t = 0; t < n_triangles; ++t) {
+            auto hard = next_cluster != clusters.end() && *next_cluster == t;
+            if (hard) {
+                ++next_cluster;
+            }
+
+            if (t == 0 || hard ||
+                (t > cluster_start && float(cluster_misses) <= threshold * float(t - cluster_start))) {
+                starts.push_back(t);
+                cluster_start = t;
+                cluster_misses = 0;
+                n_misses += MESH_OPTIMIZER_CACHE_SIZE; // flush
+            }
+
+            for (auto k = 0; k < 3; ++k) {
+                auto v = indices[t * 3 + k];
+                if (miss_times[v] == 0 || n_misses - miss_times[v] >= MESH_OPTIMIZER_CACHE_SIZE) {
+                    miss_times[v] = ++n_misses;
+                    ++cluster_misses;
+                }
+            }
+        }
+    }
+    starts.push_back(n_triangles);
+
+    // area-weighted centroid and normal of every cluster and of the mesh
+    auto n_clusters = starts.size() - 1;
+    std::vector<glm::vec3> centroids(n_clusters, glm::vec3(0.0f)), normals(n_clusters, glm::vec3(0.0f));
+    std::vector<float> areas(n_clusters, 0.0f);
+
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+
+    for (size_t c = 0; c < n_clusters; ++c) {
+        for (auto t = starts[c]; t < starts[c + 1]; ++t) {
+            const auto &a = vertices[indices[t * 3]].position;
+            const auto &b = vertices[indices[t * 3 + 1]].position;
+            const auto &d = vertices[indices[t * 3 + 2]].position;
+
+            auto normal = glm::cross(b - a, d - a);
+            auto area = glm::length(normal);
+
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+
+        mesh_centroid += centroids[c];
+        mesh_area += areas[c];
+
+        if (areas[c] > 0.0f) {
+            centroids[c] /= areas[c];
+        }
+    }
+
+    if (mesh_area > 0.0f) {
+        mesh_centroid /= mesh_area;
+    }
+
+    std::vector<float> metrics(n_clusters);
+    for (size_t c = 0; c < n_clusters; ++c) {
+        auto length = glm::length(normals[c]);
+        metrics[c] = length > 0.0f ? glm::dot(centroids[c] - mesh_centroid, normals[c] / length) : 0.0f;
+    }
+
+    std::vector<size_t> order(n_clusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return metrics[a] > metrics[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (auto c : order) {
+        output.insert(output.end(), indices.begin() + starts[c] * 3, indices.begin() + starts[c + 1] * 3);
+    }
+
+    indices.swap(output);
+}
+
+/**
+ * Renumber the vertices in the order the index buffer first uses them, unused vertices last.
+ *
+ * @return for every new vertex index, the old one
+ */
+inline std::vector<unsigned int> OptimizeVertexFetch(std::vector<unsigned int> &indices, size_t n_vertices) {
+    const auto kUnassigned = ~0u;
+
+    std::vector<unsigned int> remap(n_vertices, kUnassigned); // old to new
+    std::vector<unsigned int> sources;                         // new to old
+    sources.reserve(n_vertices);
+
+    for (auto &index : indices) {
+        if (remap[index] == kUnassigned) {
+            remap[index] = unsigned(sources.size());
+            sources.push_back(index);
+        }
+        index = remap[index];
+    }
+
+    for (unsigned int v = 0; v < n_vertices; ++v) {
+        if (remap[v] == kUnassigned) {
+            sources.push_back(v);
+        }
+    }
+
+    return sources;
+}
+
+#endif // MODELS_MESH_OPTIMIZER_H_
@@ -0,0 +1,303 @@
+#ifndef MODELS_MESH_SIMPLIFIER_H_
+#define MODELS_MESH_SIMPLIFIER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#define MESH_SIMPLIFIER_MAX_PASSES 64 // collapse passes per level, each collapses a set of independent edges
+
+/**
+ * Sum of squared distances to a set of planes, weighted by triangle area.
+ */
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+    double weight = 0;
+
+    void AddPlane(const glm::dvec3 &normal, double distance, double plane_weight) {
+        xx += plane_weight * normal.x * normal.x;
+        xy += plane_weight * normal.x * normal.y;
+        xz += plane_weight * normal.x * normal.z;
+        xw += plane_weight * normal.x * distance;
+        yy += plane_weight * normal.y * normal.y;
+        yz += plane_weight * normal.y * normal.z;
+        yw += plane_weight * normal.y * distance;
+        zz += plane_weight * normal.z * normal.z;
+        zw += plane_weight * normal.z * distance;
+        ww += plane_weight * distance * distance;
+        weight += plane_weight;
+    }
+
+    Quadric &operator+=(const Quadric &other) {
+        xx += other.xx, xy += other.xy, xz += other.xz, xw += other.xw, yy += other.yy;
+        yz += other.yz, yw += other.yw, zz += other.zz, zw += other.zw, ww += other.ww;
+        weight += other.weight;
+        return *this;
+    }
+
+    /**
+     * @return area-weighted mean squared distance of a point to the planes
+     */
+    [[nodiscard]] double GetError(const glm::vec3 &point) const {
+        double x = point.x, y = point.y, z = point.z;
+        auto error = xx * x * x + yy * y * y + zz * z * z + 2.0 * (xy * x * y + xz * x * z + yz * y * z) +
+                     2.0 * (xw * x + yw * y + zw * z) + ww;
+        return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+    }
+};
+
+/**
+ * One level of detail: an index buffer into the vertices of the full-detail mesh.
+ */
+struct LodLevel {
+    std::vector<unsigned int> indices;
+    float error; // distance to the full-detail surface, in model units
+};
+
+/**
+ * Quadric error simplification (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997) by
+ * half-edge collapses: vertices only move onto one of their neighbors, so every level indexes the original vertex
+ * buffer and its attributes and blendshapes stay valid. Vertices on borders and attribute seams (several vertices at
+ * one position) are locked so the surface does not tear.
+ *
+ * Simplify() can be called with decreasing targets to build a chain of levels, each continuing from the last.
+ */
+class MeshSimplifier {
+public:
+    MeshSimplifier(const std::vector<unsigned int> &indices, const std::vector<glm::vec3> &positions)
+        : positions_(positions), result_(indices), quadrics_(positions.size()), locked_(positions.size(), 0) {
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            glm::dvec3 a = positions[indices[t]], b = positions[indices[t + 1]], c = positions[indices[t + 2]];
+            auto normal = glm::cross(b - a, c - a);
+            auto area = glm::length(normal);
+            if (area == 0.0) {
+                continue;
+            }
+
+            normal /= area;
+            for (auto k = 0; k < 3; ++k) {
+                quadrics_[indices[t + k]].AddPlane(normal, -glm::dot(normal, a), area);
+            }
+        }
+
+        LockBorders();
+        LockSeams();
+    }
+
+    /**
+     * @param target_triangles stop once the mesh has this many triangles or fewer
+     * @param max_error stop before collapses that move the surface further than this, in model units
+     * @return simplified indices
+     */
+    const std::vector<unsigned int> &Simplify(size_t target_triangles, float max_error) {
+        auto max_error_squared = double(max_error) * double(max_error);
+
+        for (auto pass = 0; pass < MESH_SIMPLIFIER_MAX_PASSES && result_.size() / 3 > target_triangles; ++pass) {
+            if (CollapsePass(target_triangles, max_error_squared) == 0) {
+                break;
+            }
+        }
+
+        return result_;
+    }
+
+    /**
+     * @return root of the largest mean squared distance of a collapsed vertex to its planes, in model units
+     */
+    [[nodiscard]] float GetError() const { return float(std::sqrt(worst_error_)); }
+
+private:
+    struct Collapse {
+        unsigned int from, to;
+        double error;
+    };
+
+    const std::vector<glm::vec3> &positions_;
+    std::vector<unsigned int> result_;
+    std::vector<Quadric> quadrics_;
+    std::vector<uint8_t> locked_;
+    double worst_error_ = 0.0;
+
+    std::vector<unsigned int> offsets_, adjacency_; // triangles of every vertex, in CSR form
+    std::vector<uint64_t> edges_;
+    std::vector<Collapse> collapses_;
+    std::vector<uint8_t> touched_;
+
+    static uint64_t GetEdgeKey(unsigned int a, unsigned int b) {
+        return a < b ? uint64_t(a) << 32 | b : uint64_t(b) << 32 | a;
+    }
+
+    void CollectEdges() {
+        edges_.clear();
+        edges_.reserve(result_.size());
+        for (size_t t = 0; t < result_.size(); t += 3) {
+            for (auto k = 0; k < 3; ++k) {
+                edges_.push_back(GetEdgeKey(result_[t + k], result_[t + (k + 1) % 3]));
+            }
+        }
+        std::sort(edges_.begin(), edges_.end());
+    }
+
+    /**
+     * Lock the vertices of edges used by a single triangle.
+     */
+    void LockBorders() {
+        CollectEdges();
+
+        for (size_t i = 0; i < edges_.size();) {
+            auto j = i + 1;
+            while (j < edges_.size() && edges_[j] == edges_[i]) {
+                ++j;
+            }
+            if (j - i == 1) {
+                locked_[edges_[i] >> 32] = locked_[edges_[i] & 0xffffffffu] = 1;
+            }
+            i = j;
+        }
+    }
+
+    /**
+     * Lock vertices sharing their position with another vertex, they differ in other attributes.
+     */
+    void LockSeams() {
+        std::vector<unsigned int> by_position(positions_.size());
+        std::iota(by_position.begin(), by_position.end(), 0);
+        std::sort(by_position.begin(), by_position.end(), [&](unsigned int a, unsigned int b) {
+            const auto &p = positions_[a], &q = positions_[b];
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        });
+
+        for (size_t i = 1; i < by_position.size(); ++i) {
+            if (positions_[by_position[i]] == positions_[by_position[i - 1]]) {
+                locked_[by_position[i]] = locked_[by_position[i - 1]] = 1;
+            }
+        }
+    }
+
+    /**
+     * Collapse edges cheapest first, at most one per vertex neighborhood so the checks see current triangles.
+     *
+     * @return number of edges collapsed
+     */
+    size_t CollapsePass(size_t target_triangles, double max_error_squared) {
+        auto n_vertices = positions_.size();
+
+        offsets_.assign(n_vertices + 1, 0);
+        for (auto index : result_) {
+            ++offsets_[index + 1];
+        }
+        std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+
+        adjacency_.resize(result_.size());
+        {
+            std::vector<unsigned int> fill(offsets_.begin(), offsets_.end() - 1);
+            for (size_t i = 0; i < result_.size(); ++i) {
+                adjacency_[fill[result_[i]]++] = unsigned(i / 3);
+            }
+        }
+
+        // cheapest direction of every edge
+        CollectEdges();
+        edges_.erase(std::unique(edges_.begin(), edges_.end()), edges_.end());
+
+        collapses_.clear();
+        for (auto edge : edges_) {
+            auto a = unsigned(edge >> 32), b = unsigned(edge & 0xffffffffu);
+
+            auto quadric = quadrics_[a];
+            quadric += quadrics_[b];
+
+            auto error_ab = locked_[a] ? INFINITY : quadric.GetError(positions_[b]);
+            auto error_ba = locked_[b] ? INFINITY : quadric.GetError(positions_[a]);
+            if (std::isinf(error_ab) && std::isinf(error_ba)) {
+                continue;
+            }
+
+            collapses_.push_back(error_ab <= error_ba ? Collapse{a, b, error_ab} : Collapse{b, a, error_ba});
+        }
+        std::sort(collapses_.begin(), collapses_.end(), [](const Collapse &x, const Collapse &y) {
+            return x.error < y.error;
+        });
+
+        auto n_to_remove = result_.size() / 3 - target_triangles;
+        size_t n_removed = 0, n_collapsed = 0;
+        touched_.assign(n_vertices, 0);
+
+        for (const auto &collapse : collapses_) {
+            if (collapse.error > max_error_squared || n_removed >= n_to_remove) {
+                break;
+            }
+            if (touched_[collapse.from] || touched_[collapse.to]) {
+                continue;
+            }
+
+            size_t n_degenerate = 0;
+            if (Flips(collapse, n_degenerate)) {
+                continue;
+            }
+
+            for (auto a = offsets_[collapse.from]; a < offsets_[collapse.from + 1]; ++a) {
+                auto *triangle = &result_[adjacency_[a] * 3];
+                for (auto k = 0; k < 3; ++k) {
+                    touched_[triangle[k]] = 1;
+                    if (triangle[k] == collapse.from) {
+                        triangle[k] = collapse.to;
+                    }
+                }
+            }
+
+            quadrics_[collapse.to] += quadrics_[collapse.from];
+            worst_error_ = std::max(worst_error_, collapse.error);
+            n_removed += n_degenerate;
+            ++n_collapsed;
+        }
+
+        // drop the triangles that lost an edge
+        size_t n_kept = 0;
+        for (size_t t = 0; t < result_.size(); t += 3) {
+            auto a = result_[t], b = result_[t + 1], c = result_[t + 2];
+            if (a != b && b != c && a != c) {
+                result_[n_kept++] = a;
+                result_[n_kept++] = b;
+                result_[n_kept++] = c;
+            }
+        }
+        result_.resize(n_kept);
+
+        return n_collapsed;
+    }
+
+    /**
+     * @param n_degenerate set to the triangles the collapse removes
+     * @return true if the collapse would turn a remaining triangle around
+     */
+    bool Flips(const Collapse &collapse, size_t &n_degenerate) const {
+        for (auto a = offsets_[collapse.from]; a < offsets_[collapse.from + 1]; ++a) {
+            const auto *triangle = &result_[adjacency_[a] * 3];
+            if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                ++n_degenerate;
+                continue;
+            }
+
+            glm::vec3 before[3], after[3];
+            for (auto k = 0; k < 3; ++k) {
+                before[k] = positions_[triangle[k]];
+                after[k] = triangle[k] == collapse.from ? positions_[collapse.to] : before[k];
+            }
+
+            auto normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+            auto normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normal_before, normal_after) <= 0.0f) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+#endif // MODELS_MESH_SIMPLIFIER_H_
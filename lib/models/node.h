@@ -1,12 +1,16 @@
 #ifndef MODELING_NODE_H_
 #define MODELING_NODE_H_
 
+#include <memory>
+
 #include "glm/gtx/euler_angles.hpp"
 #include "glm/gtx/matrix_decompose.hpp"
 #include "glm/gtx/transform.hpp"
 
 #include "../shaders/shader.h"
 #include "mesh.h"
+#include "render_queue.h"
+#include "transforms.h"
 
 inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4 *from) {
     glm::mat4 to;
@@ -42,20 +46,15 @@ public:
          TextureManager &manager,
          const Node *parent) {
 
-        local_transform_ = aiMatrix4x4ToGlm(&node->mTransformation);
-        if (parent) {
-            parent_ = parent;
-            world_transform_ = parent->GetWorldTransform() * local_transform_;
-        }
+        auto local_transform = aiMatrix4x4ToGlm(&node->mTransformation);
 
         name_ = std::string(node->mName.C_Str());
 
+        glm::vec3 scale, translation;
         glm::quat rotation;
         glm::vec3 skew;
         glm::vec4 perspective;
-        glm::decompose(local_transform_, scale_, rotation, translation_, skew, perspective);
-
-        rotation_ = glm::eulerAngles(rotation);
+        glm::decompose(local_transform, scale, rotation, translation, skew, perspective);
 
         if (skew[0] != 0.0f || skew[1] != 0.0f || skew[2] != 0.0f) {
             std::cout << "WARNING: Model node with skew is not supported" << std::endl;
@@ -65,38 +64,68 @@ public:
             std::cout << "WARNING: Model node with perspective is not supported" << std::endl;
         }
 
+        if (parent) {
+            transforms_ = parent->transforms_;
+        } else {
+            owned_transforms_ = std::make_unique<TransformHierarchy>();
+            transforms_ = owned_transforms_.get();
+        }
+
+        transform_index_ = transforms_->Add(parent ? int32_t(parent->transform_index_) : TransformHierarchy::kNoParent,
+                                            local_transform,
+                                            translation,
+                                            glm::eulerAngles(rotation),
+                                            scale);
+
         for (auto i = 0; i < node->mNumMeshes; i++) {
             meshes_.push_back(new Mesh(scene->mMeshes[node->mMeshes[i]], scene, base_path, manager));
         }
+        UpdateLocalBounds();
+        n_subtree_meshes_ = meshes_.size();
 
         for (auto i = 0; i < node->mNumChildren; i++) {
             children_.push_back(new Node(node->mChildren[i], scene, base_path, manager, this));
+            n_subtree_meshes_ += children_.back()->GetSubtreeMeshCount();
         }
+
+        transforms_->EndSubtree(transform_index_);
     }
 
     /**
-     * @param parent_textures - texture units used by parent nodes
+     * Add the draws of this node and its children to a render queue, skipping the subtrees outside of its view.
+     *
+     * @param env_map cube map of the closest ancestor with one, 0 for none
+     * @param test of the closest ancestor tested against the view frustum, FRUSTUM_INSIDE skips further tests
      */
-    void Draw(GLuint parent_texture_unit, ShaderProgram *shader) {
-        shader->SetMat4("modelMatrix", world_transform_);
-        shader->SetMat4("modelNormalMatrix", glm::transpose(glm::inverse(world_transform_)));
+    void Enqueue(RenderQueue &queue,
+                 ShaderProgram *shader,
+                 GLuint env_map,
+                 FrustumTest test = FRUSTUM_INTERSECTS) const {
+        if (n_subtree_meshes_ == 0) {
+            return;
+        }
 
-        auto texture_unit = parent_texture_unit;
-        if (env_map_.role == NODE_TEXTURE_ROLE_ENV_MAP) {
-            glActiveTexture(GL_TEXTURE0 + texture_unit);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, env_map_.name);
-            shader->SetInt("envMap", GLint(texture_unit));
-            ++texture_unit;
+        if (test != FRUSTUM_INSIDE) {
+            test = queue.TestSubtree(transforms_->GetBounds(transform_index_), n_subtree_meshes_);
+            if (test == FRUSTUM_OUTSIDE) {
+                return;
+            }
         }
 
-        for (auto &mesh : meshes_) {
-            mesh->Draw(texture_unit, shader);
+        if (env_map_.role == NODE_TEXTURE_ROLE_ENV_MAP) {
+            env_map = env_map_.name;
         }
 
-        glCheckError();
+        if (!meshes_.empty()) {
+            auto transform = queue.AddTransform(transforms_->GetWorldTransform(transform_index_),
+                                                transforms_->GetNormalTransform(transform_index_));
+            for (auto &mesh : meshes_) {
+                queue.AddMesh(mesh, shader, transform, env_map, test);
+            }
+        }
 
         for (auto &child : children_) {
-            child->Draw(texture_unit, shader);
+            child->Enqueue(queue, shader, env_map, test);
         }
     }
 
@@ -124,11 +153,53 @@ public:
         }
     }
 
-    glm::vec3 GetRotation() { return rotation_; }
+    void GetCacheStatistics(VertexCacheStatistics &before, VertexCacheStatistics &after) const {
+        for (const auto &mesh : meshes_) {
+            mesh->GetCacheStatistics(before, after);
+        }
+
+        for (const auto &child : children_) {
+            child->GetCacheStatistics(before, after);
+        }
+    }
+
+    /**
+     * @param triangles triangles of every level of detail are added to it, meshes with fewer levels add their coarsest
+     */
+    void GetLodTriangles(std::vector<size_t> &triangles) const {
+        for (const auto &mesh : meshes_) {
+            const auto &lods = mesh->GetLods();
+            if (triangles.size() < lods.size()) {
+                triangles.resize(lods.size(), triangles.empty() ? 0 : triangles.back());
+            }
+            for (size_t i = 0; i < triangles.size(); ++i) {
+                triangles[i] += lods[std::min(i, lods.size() - 1)].count / 3;
+            }
+        }
+
+        for (const auto &child : children_) {
+            child->GetLodTriangles(triangles);
+        }
+    }
+
+    /**
+     * @return meshes of the node and all of its descendants
+     */
+    [[nodiscard]] size_t GetSubtreeMeshCount() const { return n_subtree_meshes_; }
+
+    glm::vec3 GetRotation() { return transforms_->GetRotation(transform_index_); }
+
+    [[nodiscard]] glm::vec3 GetWorldPosition() const { return GetWorldTransform()[3]; }
 
-    [[nodiscard]] glm::vec3 GetWorldPosition() const { return world_transform_[3]; }
+    [[nodiscard]] const glm::mat4 &GetWorldTransform() const {
+        return transforms_->GetWorldTransform(transform_index_);
+    }
 
-    [[nodiscard]] glm::mat4 GetWorldTransform() const { return world_transform_; }
+    /**
+     * @return world-space bounding box of the node and its descendants, the first query after a node moved refits
+     *         the stale transforms and boxes of the whole hierarchy, as drawing does when it culls the root
+     */
+    [[nodiscard]] const BoundingBox &GetBounds() const { return transforms_->GetBounds(transform_index_); }
 
     void Initialize() {
         for (auto &mesh : meshes_) {
@@ -154,6 +225,7 @@ public:
         for (auto i = 0; i < node->mNumMeshes; ++i) {
             meshes_[i]->LoadDeltaMesh(scene->mMeshes[node->mMeshes[i]]);
         }
+        UpdateLocalBounds(); // the delta meshes can reach out of the node's bounds
 
         for (auto i = 0; i < node->mNumChildren; ++i) {
             children_[i]->LoadDeltaNodes(node->mChildren[i], scene);
@@ -161,10 +233,24 @@ public:
     }
 
     virtual void Pick(MeshVertexPickResult &global_result, ShaderProgram *shader) const {
-        shader->SetMat4("modelMatrix", world_transform_);
+        auto world_transform = GetWorldTransform();
 
         for (auto &mesh : meshes_) {
-            mesh->Pick(global_result, world_transform_, mesh);
+            auto draw_index = DrawDataRing::GetInstance().Write(
+                DrawData{.model_matrix = world_transform * mesh->GetPositionTransform()});
+            shader->SetInt("drawIndex", draw_index);
+
+            auto distance = global_result.distance;
+            mesh->Pick(global_result, world_transform, mesh);
+
+            // edits can move the vertex out of the node's bounds
+            if (global_result.distance < distance) {
+                global_result.update_position = [this, update = std::move(global_result.update_position)](
+                                                    const glm::vec3 &position) {
+                    update(position);
+                    UpdateLocalBounds();
+                };
+            }
         }
 
         for (auto &child : children_) {
@@ -175,13 +261,12 @@ public:
     }
 
     void Rotate(float delta_pitch, float delta_yaw, float delta_roll) {
-        rotation_ += glm::vec3(delta_pitch, delta_yaw, delta_roll);
-        UpdateTransformMatrix();
+        auto rotation = transforms_->GetRotation(transform_index_) + glm::vec3(delta_pitch, delta_yaw, delta_roll);
+        transforms_->SetRotation(transform_index_, rotation);
     }
 
     void Scale(float delta_scale) {
-        scale_ *= delta_scale;
-        UpdateTransformMatrix();
+        transforms_->SetScale(transform_index_, transforms_->GetScale(transform_index_) * delta_scale);
     }
 
     void SetDeltaWeight(size_t index, float weight) {
@@ -196,64 +281,59 @@ public:
 
     void SetEnvMap(NodeTexture env_map) { env_map_ = env_map; }
 
-    void SetPosition(float x, float y, float z) {
-        translation_ = glm::vec3(x, y, z);
-        UpdateTransformMatrix();
-    }
+    void SetPosition(float x, float y, float z) { transforms_->SetTranslation(transform_index_, glm::vec3(x, y, z)); }
 
-    void SetRotation(const glm::vec3 &value) {
-        rotation_ = value;
-        UpdateTransformMatrix();
-    }
+    void SetRotation(const glm::vec3 &value) { transforms_->SetRotation(transform_index_, value); }
 
     void Translate(float delta_x, float delta_y, float delta_z) {
-        translation_ += glm::vec3(delta_x, delta_y, delta_z);
-        UpdateTransformMatrix();
+        auto translation = transforms_->GetTranslation(transform_index_) + glm::vec3(delta_x, delta_y, delta_z);
+        transforms_->SetTranslation(transform_index_, translation);
     }
 
     void UpdateDeltaWeights() {
         for (auto &mesh : meshes_) {
             mesh->UpdateDeltaWeights();
         }
+        UpdateLocalBounds();
 
         for (auto &child : children_) {
             child->UpdateDeltaWeights();
         }
     }
 
-    void UpdateTransformMatrix() {
-        local_transform_ = glm::mat4(1.0f);
-        local_transform_ *= glm::translate(translation_);
-        local_transform_ *= glm::eulerAngleXYZ(rotation_.x, rotation_.y, rotation_.z);
-        local_transform_ *= glm::scale(scale_);
-
-        world_transform_ = parent_ ? parent_->GetWorldTransform() * local_transform_ : local_transform_;
-
-        for (auto &child : children_) {
-            child->UpdateTransformMatrix();
-        }
-    }
-
 protected:
     std::vector<Node *> children_;
 
-    glm::mat4 world_transform_{1.0f};
+    TransformHierarchy *transforms_;                       // shared by all nodes of the tree
+    std::unique_ptr<TransformHierarchy> owned_transforms_; // root nodes only
+    size_t transform_index_;
+    size_t n_subtree_meshes_ = 0; // of the node and its descendants, counted as culled with the subtree
 
-    Node() {}
+    /**
+     * Root node with an identity transform, children have to be added before EndSubtree() of transform_index_.
+     */
+    Node()
+        : transforms_(new TransformHierarchy()), owned_transforms_(transforms_),
+          transform_index_(transforms_->Add(
+              TransformHierarchy::kNoParent, glm::mat4(1.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f))) {}
 
 private:
     std::vector<Mesh *> meshes_;
 
-    const Node *parent_ = nullptr;
+    /**
+     * Refit the node's bounds to its meshes, after loading or editing them.
+     */
+    void UpdateLocalBounds() const {
+        BoundingBox bounds;
+        for (const auto &mesh : meshes_) {
+            bounds.Add(mesh->GetBounds());
+        }
+        transforms_->SetLocalBounds(transform_index_, bounds);
+    }
+
     std::string name_;
 
     NodeTexture env_map_{.role = 0};
-
-    glm::vec3 scale_{1.0f};
-    glm::vec3 rotation_{0.0f};
-    glm::vec3 translation_{0.0f};
-
-    glm::mat4 local_transform_{1.0f};
 };
 
 #endif // MODELING_NODE_H_
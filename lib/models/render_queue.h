@@ -0,0 +1,416 @@
+#ifndef MODELS_RENDER_QUEUE_H_
+#define MODELS_RENDER_QUEUE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "../gl_state.h"
+#include "../profiling/trace.h"
+#include "../shaders/draw_data.h"
+#include "../shaders/shader.h"
+#include "bounds.h"
+#include "mesh.h"
+
+#define RENDER_QUEUE_MAX_PROGRAMS 256    // programs told apart by the sort key, further ones share its last id
+#define RENDER_QUEUE_LOD_PIXEL_ERROR 1.0f // simplification error allowed on screen when choosing levels of detail
+
+/**
+ * One mesh draw collected by a scene traversal.
+ */
+struct RenderPacket {
+    const Mesh *mesh;
+    ShaderProgram *shader;
+    uint32_t program;   // id of the shader in the queue, by order of first use
+    uint32_t transform; // index of the mesh's transforms in the queue
+    GLuint env_map;     // cube map of the node or its closest ancestor, 0 for none
+    float depth;        // view-space distance of the mesh center
+    size_t lod;         // level of detail, drawn by both the depth-only and the shading pass
+};
+
+/**
+ * Meshes drawn and culled by the traversals of a frame.
+ */
+struct RenderQueueCounters {
+    size_t visible_meshes = 0;
+    size_t culled_meshes = 0;   // outside of the view frustum, alone or with their subtree
+    size_t culled_subtrees = 0; // nodes skipped with all of their descendants
+    size_t frustum_tests = 0;
+
+    RenderQueueCounters &operator+=(const RenderQueueCounters &other) {
+        visible_meshes += other.visible_meshes;
+        culled_meshes += other.culled_meshes;
+        culled_subtrees += other.culled_subtrees;
+        frustum_tests += other.frustum_tests;
+        return *this;
+    }
+};
+
+/**
+ * Draws of one or more scenes, collected by traversing the node hierarchy, sorted by 64-bit keys and then submitted.
+ *
+ * Sort keys, most significant bits first:
+ *
+ *   program (8) | shader features (8) | material (16) | depth (32)
+ *
+ * so the queue switches programs, variants and materials as rarely as possible, and draws with the same state go
+ * front-to-back. Depth-only submits sort by depth alone. The keys are sorted with an LSD radix sort, skipping bytes
+ * that are equal in all keys.
+ *
+ * Each packet draws the coarsest level of detail of its mesh whose simplification error stays within
+ * RENDER_QUEUE_LOD_PIXEL_ERROR pixels on screen, chosen when it is added. Meshes outside of the view frustum are not
+ * added at all: traversals test node subtrees with TestSubtree() first, and only test the meshes of subtrees that
+ * intersect the frustum.
+ */
+class RenderQueue {
+public:
+    static RenderQueue &GetInstance() {
+        static RenderQueue instance;
+        return instance;
+    }
+
+    /**
+     * @param view_matrix camera of the next traversals, for the draw depths
+     */
+    void SetViewMatrix(const glm::mat4 &view_matrix) {
+        view_matrix_ = view_matrix;
+        frustum_.Set(projection_matrix_ * view_matrix_);
+    }
+
+    /**
+     * @param projection_matrix perspective projection of the next traversals, for culling and the levels of detail
+     * @param viewport_height in pixels
+     */
+    void SetProjection(const glm::mat4 &projection_matrix, float viewport_height) {
+        projection_matrix_ = projection_matrix;
+        lod_scale_ = projection_matrix[1][1] * viewport_height * 0.5f;
+        frustum_.Set(projection_matrix_ * view_matrix_);
+    }
+
+    /**
+     * Draw meshes outside of the view frustum too, for comparisons.
+     */
+    void SetCullingEnabled(bool enabled) { culling_enabled_ = enabled; }
+
+    [[nodiscard]] bool IsCullingEnabled() const { return culling_enabled_; }
+
+    /**
+     * Draw every mesh at full detail, for comparisons.
+     */
+    void SetLodEnabled(bool enabled) { lod_enabled_ = enabled; }
+
+    [[nodiscard]] bool IsLodEnabled() const { return lod_enabled_; }
+
+    void Clear() {
+        packets_.clear();
+        transforms_.clear();
+        programs_.clear();
+    }
+
+    [[nodiscard]] bool IsEmpty() const { return packets_.empty(); }
+
+    [[nodiscard]] size_t GetPacketCount() const { return packets_.size(); }
+
+    /**
+     * Finish the counters of the last frame and start counting the next one.
+     */
+    void BeginFrame() {
+        last_frame_counters_ = counters_;
+        totals_ += counters_;
+        counters_ = RenderQueueCounters();
+    }
+
+    [[nodiscard]] const RenderQueueCounters &GetLastFrameCounters() const { return last_frame_counters_; }
+
+    /**
+     * @return counters summed over all finished frames since ResetTotals()
+     */
+    [[nodiscard]] const RenderQueueCounters &GetTotals() const { return totals_; }
+
+    void ResetTotals() { totals_ = RenderQueueCounters(); }
+
+    /**
+     * Test the world-space bounds of a node subtree against the view frustum.
+     *
+     * @param n_meshes meshes in the subtree, counted as culled if it is outside
+     * @return FRUSTUM_INSIDE without a projection or with culling disabled
+     */
+    FrustumTest TestSubtree(const BoundingBox &bounds, size_t n_meshes) {
+        if (!IsCulling()) {
+            return FRUSTUM_INSIDE;
+        }
+
+        ++counters_.frustum_tests;
+        auto test = frustum_.Test(bounds);
+        if (test == FRUSTUM_OUTSIDE) {
+            ++counters_.culled_subtrees;
+            counters_.culled_meshes += n_meshes;
+        }
+        return test;
+    }
+
+    /**
+     * @param normal_transform transposed inverse of world_transform
+     * @return index of the transforms for AddMesh()
+     */
+    uint32_t AddTransform(const glm::mat4 &world_transform, const glm::mat4 &normal_transform) {
+        transforms_.push_back(DrawData{.model_matrix = world_transform, .model_normal_matrix = normal_transform});
+        return uint32_t(transforms_.size() - 1);
+    }
+
+    /**
+     * @param transform index of the node's transforms, meshes with quantized positions add their own
+     * @param test of the node's subtree, FRUSTUM_INSIDE adds the mesh without testing its own bounds
+     */
+    void AddMesh(const Mesh *mesh,
+                 ShaderProgram *shader,
+                 uint32_t transform,
+                 GLuint env_map,
+                 FrustumTest test = FRUSTUM_INTERSECTS) {
+        const auto &model_matrix = transforms_[transform].model_matrix;
+        auto world_scale = GetMaxScale(model_matrix);
+
+        if (test != FRUSTUM_INSIDE && IsCulling()) {
+            ++counters_.frustum_tests;
+            auto sphere = BoundingSphere{
+                .center = glm::vec3(model_matrix * glm::vec4(mesh->GetCenter(), 1.0f)),
+                .radius = mesh->GetRadius() * world_scale,
+            };
+            if (frustum_.Test(sphere) == FRUSTUM_OUTSIDE) {
+                ++counters_.culled_meshes;
+                return;
+            }
+        }
+        ++counters_.visible_meshes;
+
+        auto center = view_matrix_ * model_matrix * glm::vec4(mesh->GetCenter(), 1.0f);
+        auto lod = SelectLod(mesh, world_scale, -center.z);
+
+        if (mesh->GetLayout()->quantizes_positions) {
+            transform = AddTransform(transforms_[transform].model_matrix * mesh->GetPositionTransform(),
+                                     transforms_[transform].model_normal_matrix);
+        }
+
+        packets_.push_back(RenderPacket{
+            .mesh = mesh,
+            .shader = shader,
+            .program = GetProgramId(shader),
+            .transform = transform,
+            .env_map = env_map,
+            .depth = -center.z,
+            .lod = lod,
+        });
+    }
+
+    /**
+     * Draw all packets with their shaders and materials. Each packet binds its own shader variant, callers need not
+     * have one in use.
+     */
+    void Submit() {
+        TRACE_SCOPE("RenderQueue::Submit");
+
+        SortPackets(false);
+
+        const ShaderProgram *last_shader = nullptr;
+        auto last_transform = kNoTransform;
+        GLint draw_index = 0;
+
+        for (auto i : order_) {
+            const auto &packet = packets_[i];
+
+            // per-packet uniforms go to the packet's variant, whatever was in use before the queue
+            packet.mesh->Bind(packet.shader);
+
+            if (packet.transform != last_transform) {
+                draw_index = DrawDataRing::GetInstance().Write(transforms_[packet.transform]);
+            }
+
+            if (packet.transform != last_transform || packet.shader != last_shader) {
+                packet.shader->SetInt("drawIndex", draw_index);
+                last_transform = packet.transform;
+                last_shader = packet.shader;
+            }
+
+            if (packet.env_map != 0) {
+                GlStateCache::GetInstance().BindTexture(0, GL_TEXTURE_CUBE_MAP, packet.env_map);
+                packet.shader->SetInt("envMap", 0);
+            }
+
+            packet.mesh->DrawBound(packet.lod);
+        }
+
+        glCheckError();
+    }
+
+    /**
+     * Draw the positions of all packets with a depth-only shader, front-to-back.
+     *
+     * @param shader depth-only shader, in use
+     */
+    void SubmitDepth(ShaderProgram *shader) {
+        TRACE_SCOPE("RenderQueue::SubmitDepth");
+
+        SortPackets(true);
+
+        auto last_transform = kNoTransform;
+        for (auto i : order_) {
+            const auto &packet = packets_[i];
+
+            if (packet.transform != last_transform) {
+                auto draw_index = DrawDataRing::GetInstance().Write(transforms_[packet.transform]);
+                shader->SetInt("drawIndex", draw_index);
+                last_transform = packet.transform;
+            }
+
+            packet.mesh->DrawDepth(packet.lod);
+        }
+
+        glCheckError();
+    }
+
+private:
+    static constexpr uint32_t kNoTransform = ~uint32_t(0);
+
+    glm::mat4 view_matrix_{1.0f};
+    glm::mat4 projection_matrix_{1.0f};
+    Frustum frustum_;        // of projection_matrix_ * view_matrix_, in world space
+    float lod_scale_ = 0.0f; // pixels per view-space unit at distance 1, 0 until a projection is set
+    bool lod_enabled_ = true, culling_enabled_ = true;
+
+    RenderQueueCounters counters_, last_frame_counters_, totals_;
+
+    std::vector<RenderPacket> packets_;
+    std::vector<DrawData> transforms_; // world and normal matrices of the queued nodes
+    std::vector<const ShaderProgram *> programs_; // by program id
+
+    std::vector<uint64_t> keys_, sorted_keys_;
+    std::vector<uint32_t> order_, sorted_order_;
+
+    RenderQueue() = default;
+
+    /**
+     * @param world_scale largest scale of the model matrix
+     * @param depth view-space distance of the mesh center
+     * @return coarsest level of detail whose error projects to at most RENDER_QUEUE_LOD_PIXEL_ERROR pixels at the
+     *         nearest point of the mesh's bounding sphere, 0 if the camera is inside the sphere
+     */
+    [[nodiscard]] size_t SelectLod(const Mesh *mesh, float world_scale, float depth) const {
+        const auto &lods = mesh->GetLods();
+        if (!lod_enabled_ || lod_scale_ <= 0.0f || lods.size() < 2) {
+            return 0;
+        }
+
+        auto distance = depth - mesh->GetRadius() * world_scale;
+        if (!(distance > 0.0f)) {
+            return 0;
+        }
+
+        // error in pixels = error * world_scale * lod_scale_ / distance
+        auto max_error = RENDER_QUEUE_LOD_PIXEL_ERROR * distance / (world_scale * lod_scale_);
+
+        size_t lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error <= max_error) {
+            ++lod;
+        }
+        return lod;
+    }
+
+    /**
+     * @return length of the longest axis of a transform, which scales bounding radii and distances
+     */
+    static float GetMaxScale(const glm::mat4 &transform) {
+        return std::max({glm::length(glm::vec3(transform[0])),
+                         glm::length(glm::vec3(transform[1])),
+                         glm::length(glm::vec3(transform[2]))});
+    }
+
+    [[nodiscard]] bool IsCulling() const { return culling_enabled_ && lod_scale_ > 0.0f; }
+
+    uint32_t GetProgramId(const ShaderProgram *shader) {
+        auto it = std::find(programs_.begin(), programs_.end(), shader);
+        if (it == programs_.end()) {
+            programs_.push_back(shader);
+            it = programs_.end() - 1;
+        }
+
+        return std::min(uint32_t(it - programs_.begin()), uint32_t(RENDER_QUEUE_MAX_PROGRAMS - 1));
+    }
+
+    /**
+     * @return bits of a non-negative float, which order like the float
+     */
+    static uint32_t GetDepthBits(float depth) {
+        depth = std::max(depth, 0.0f); // also maps NaN to 0
+
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits;
+    }
+
+    static uint64_t GetKey(const RenderPacket &packet, bool depth_only) {
+        uint64_t key = GetDepthBits(packet.depth);
+        if (depth_only) {
+            return key;
+        }
+
+        key |= uint64_t(packet.mesh->GetShaderFeatures() & 0xffu) << 48;
+
+        const auto *material = packet.mesh->GetMaterial();
+        if (material != nullptr) {
+            key |= uint64_t(std::min(material->index, size_t(0xffff))) << 32;
+        }
+
+        return key | uint64_t(packet.program) << 56;
+    }
+
+    /**
+     * Fill order_ with the packet indices sorted by key, packets with equal keys stay in traversal order.
+     */
+    void SortPackets(bool depth_only) {
+        auto n_packets = packets_.size();
+
+        keys_.resize(n_packets);
+        for (size_t i = 0; i < n_packets; ++i) {
+            keys_[i] = GetKey(packets_[i], depth_only);
+        }
+
+        order_.resize(n_packets);
+        std::iota(order_.begin(), order_.end(), 0);
+
+        sorted_keys_.resize(n_packets);
+        sorted_order_.resize(n_packets);
+
+        for (unsigned int shift = 0; shift < 64; shift += 8) {
+            size_t offsets[256] = {};
+            for (auto key : keys_) {
+                ++offsets[(key >> shift) & 0xff];
+            }
+
+            if (n_packets == 0 || offsets[(keys_[0] >> shift) & 0xff] == n_packets) {
+                continue; // byte is equal in all keys
+            }
+
+            size_t offset = 0;
+            for (auto &count : offsets) {
+                auto next = offset + count;
+                count = offset;
+                offset = next;
+            }
+
+            for (size_t i = 0; i < n_packets; ++i) {
+                auto position = offsets[(keys_[i] >> shift) & 0xff]++;
+                sorted_keys_[position] = keys_[i];
+                sorted_order_[position] = order_[i];
+            }
+
+            keys_.swap(sorted_keys_);
+            order_.swap(sorted_order_);
+        }
+    }
+};
+
+#endif // MODELS_RENDER_QUEUE_H_
@@ -13,10 +13,16 @@
 class Scene : public Node {
 public:
     static bool CreateFromFile(const char *file_path, Scene *&model, TextureManager &texture_manager) {
+        TRACE_SCOPE_DETAIL("Scene::CreateFromFile", file_path);
+
         auto base_path = std::filesystem::path(file_path).parent_path();
 
         Assimp::Importer importer;
-        auto scene = importer.ReadFile(file_path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        const aiScene *scene;
+        {
+            TRACE_SCOPE("Assimp::Importer::ReadFile");
+            scene = importer.ReadFile(file_path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        }
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
             std::cerr << "FATAL: Failed to load mesh from file: " << file_path << std::endl;
@@ -31,14 +37,41 @@ public:
         std::cout << "DEBUG: Loaded model with " << mesh_count << " meshes and " << node_count << " nodes."
                   << std::endl;
 
+        VertexCacheStatistics before, after;
+        model->GetCacheStatistics(before, after);
+        if (after.n_vertices != before.n_vertices) {
+            std::cout << "INFO: Welded " << before.n_vertices << " vertices into " << after.n_vertices << std::endl;
+        }
+        std::cout << "INFO: Vertex cache ACMR " << before.GetAcmr() << " -> " << after.GetAcmr() << ", ATVR "
+                  << before.GetAtvr() << " -> " << after.GetAtvr() << " (" << MESH_OPTIMIZER_CACHE_SIZE
+                  << "-entry FIFO)" << std::endl;
+
+        std::vector<size_t> lod_triangles;
+        model->GetLodTriangles(lod_triangles);
+        if (lod_triangles.size() > 1) {
+            std::cout << "INFO: Levels of detail:";
+            for (auto triangles : lod_triangles) {
+                std::cout << " " << triangles;
+            }
+            std::cout << " triangles" << std::endl;
+        }
+
+        ShaderProgram::PollPending();
+
         return true;
     }
 
     static bool LoadDeltaFromFile(const char *file_path, Scene *model) {
+        TRACE_SCOPE_DETAIL("Scene::LoadDeltaFromFile", file_path);
+
         auto base_path = std::filesystem::path(file_path).parent_path();
 
         Assimp::Importer importer;
-        auto scene = importer.ReadFile(file_path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        const aiScene *scene;
+        {
+            TRACE_SCOPE("Assimp::Importer::ReadFile");
+            scene = importer.ReadFile(file_path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        }
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
             std::cerr << "FATAL: Failed to load mesh from file: " << file_path << std::endl;
@@ -48,10 +81,22 @@ public:
 
         model->LoadDeltaNodes(scene->mRootNode, scene);
 
+        ShaderProgram::PollPending();
+
         return true;
     }
 
-    void Draw(ShaderProgram *shader_program) { Node::Draw(0, shader_program); }
+    /**
+     * Draw all meshes through the render queue, sorted by program, material and depth.
+     */
+    void Draw(ShaderProgram *shader_program) {
+        TRACE_SCOPE("Scene::Draw");
+
+        auto &queue = RenderQueue::GetInstance();
+        queue.Clear();
+        Enqueue(queue, shader_program, 0);
+        queue.Submit();
+    }
 
     void GetSceneSummary(unsigned int &mesh_count, unsigned int &node_count) {
         children_[0]->GetNodeSummary(mesh_count, node_count);
@@ -64,6 +109,8 @@ public:
 private:
     explicit Scene(const aiScene *scene, const std::filesystem::path &base_path, TextureManager &texture_manager) {
         children_.push_back(new Node(scene->mRootNode, scene, base_path, texture_manager, this));
+        n_subtree_meshes_ = children_[0]->GetSubtreeMeshCount();
+        transforms_->EndSubtree(transform_index_);
     }
 };
 
@@ -6,6 +6,7 @@
 #include <map>
 #include <string>
 
+#include "../profiling/trace.h"
 #include "../utils.h"
 #include <stbi/stb_image.h>
 
@@ -90,6 +91,8 @@ public:
             return mesh_textures_[filename];
         }
 
+        TRACE_SCOPE_DETAIL("TextureManager::LoadTexture2D", filename.c_str());
+
         GLuint texture_id;
         glGenTextures(1, &texture_id);
         glBindTexture(GL_TEXTURE_2D, texture_id);
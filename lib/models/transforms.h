@@ -0,0 +1,255 @@
+#ifndef MODELS_TRANSFORMS_H_
+#define MODELS_TRANSFORMS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtx/euler_angles.hpp"
+#include "glm/gtx/transform.hpp"
+
+#include "bounds.h"
+
+/**
+ * Transforms of a node tree, stored as arrays in pre-order, so every parent comes before its children and every
+ * subtree is one contiguous range.
+ *
+ * Changing a node only marks it and its subtree stale. Update() then recomputes the stale world and normal matrices
+ * in one linear sweep from the first stale node, parents always being done before their children. Reading the world
+ * transform of a stale node in between, as IK does after every joint it moves, only recomputes the node's ancestors.
+ *
+ * Every node also has a world-space bounding box of its subtree, for culling. Changing a node's transform or local
+ * bounds marks its subtree and its ancestors, and Update() refits the marked boxes bottom-up in a reverse sweep.
+ */
+class TransformHierarchy {
+public:
+    static constexpr int32_t kNoParent = -1;
+
+    /**
+     * Append a node after all nodes added so far, its children are to be added next.
+     *
+     * @param local initial local transform, kept until the translation, rotation or scale is changed
+     * @return index of the node
+     */
+    size_t Add(int32_t parent,
+               const glm::mat4 &local,
+               const glm::vec3 &translation,
+               const glm::vec3 &rotation,
+               const glm::vec3 &scale) {
+        auto index = parents_.size();
+
+        parents_.push_back(parent);
+        subtree_ends_.push_back(uint32_t(index + 1));
+
+        translations_.push_back(translation);
+        rotations_.push_back(rotation);
+        scales_.push_back(scale);
+
+        locals_.push_back(local);
+        worlds_.push_back(local);
+        normals_.push_back(glm::mat4(1.0f));
+
+        local_bounds_.emplace_back();
+        bounds_.emplace_back();
+
+        local_dirty_.push_back(0);
+        world_dirty_.push_back(1);
+        normal_dirty_.push_back(1);
+        bounds_dirty_.push_back(0);
+        first_dirty_ = std::min(first_dirty_, index);
+        MarkBoundsDirty(index);
+
+        return index;
+    }
+
+    /**
+     * Close the subtree of a node, after all of its descendants have been added.
+     */
+    void EndSubtree(size_t index) { subtree_ends_[index] = uint32_t(parents_.size()); }
+
+    [[nodiscard]] size_t GetCount() const { return parents_.size(); }
+
+    [[nodiscard]] const glm::vec3 &GetTranslation(size_t index) const { return translations_[index]; }
+
+    [[nodiscard]] const glm::vec3 &GetRotation(size_t index) const { return rotations_[index]; }
+
+    [[nodiscard]] const glm::vec3 &GetScale(size_t index) const { return scales_[index]; }
+
+    void SetTranslation(size_t index, const glm::vec3 &translation) {
+        translations_[index] = translation;
+        MarkDirty(index);
+    }
+
+    /**
+     * @param rotation Euler angles, applied in XYZ order
+     */
+    void SetRotation(size_t index, const glm::vec3 &rotation) {
+        rotations_[index] = rotation;
+        MarkDirty(index);
+    }
+
+    void SetScale(size_t index, const glm::vec3 &scale) {
+        scales_[index] = scale;
+        MarkDirty(index);
+    }
+
+    /**
+     * @param bounds of the node's own geometry, in its local space, empty for none
+     */
+    void SetLocalBounds(size_t index, const BoundingBox &bounds) {
+        local_bounds_[index] = bounds;
+        MarkBoundsDirty(index);
+    }
+
+    /**
+     * @return world transform, recomputing the node and its stale ancestors if needed
+     */
+    const glm::mat4 &GetWorldTransform(size_t index) {
+        if (world_dirty_[index]) {
+            UpdatePath(index);
+        }
+
+        return worlds_[index];
+    }
+
+    /**
+     * @return transposed inverse of the world transform, for normals
+     */
+    const glm::mat4 &GetNormalTransform(size_t index) {
+        if (normal_dirty_[index]) {
+            Update();
+        }
+
+        return normals_[index];
+    }
+
+    /**
+     * @return world-space bounding box of the node and all of its descendants, refitting stale boxes if needed
+     */
+    const BoundingBox &GetBounds(size_t index) {
+        if (bounds_stale_) {
+            Update();
+        }
+
+        return bounds_[index];
+    }
+
+    /**
+     * Recompute all stale world and normal matrices and bounding boxes.
+     */
+    void Update() {
+        auto n_nodes = parents_.size();
+
+        for (auto i = first_dirty_; i < n_nodes; ++i) {
+            if (world_dirty_[i]) {
+                UpdateWorld(i);
+            }
+
+            if (normal_dirty_[i]) {
+                normals_[i] = glm::transpose(glm::inverse(worlds_[i]));
+                normal_dirty_[i] = 0;
+            }
+        }
+
+        first_dirty_ = n_nodes;
+
+        if (bounds_stale_) {
+            UpdateBounds();
+        }
+    }
+
+private:
+    // by node, in pre-order
+
+    std::vector<int32_t> parents_;       // kNoParent for roots
+    std::vector<uint32_t> subtree_ends_; // one past the last descendant
+
+    std::vector<glm::vec3> translations_, rotations_, scales_;
+    std::vector<glm::mat4> locals_, worlds_, normals_;
+    std::vector<BoundingBox> local_bounds_; // of the node's own geometry
+    std::vector<BoundingBox> bounds_;       // world space, of the whole subtree
+
+    std::vector<uint8_t> local_dirty_;  // translation, rotation or scale changed
+    std::vector<uint8_t> world_dirty_;  // node or an ancestor changed
+    std::vector<uint8_t> normal_dirty_; // world changed since the normal matrix was computed
+    std::vector<uint8_t> bounds_dirty_; // node, a descendant or an ancestor changed
+
+    size_t first_dirty_ = 0;   // nodes before it are all up to date
+    bool bounds_stale_ = true; // any bounds_dirty_ is set
+
+    std::vector<size_t> path_; // scratch for UpdatePath()
+
+    void MarkDirty(size_t index) {
+        local_dirty_[index] = 1;
+
+        std::fill(world_dirty_.begin() + index, world_dirty_.begin() + subtree_ends_[index], 1);
+        std::fill(normal_dirty_.begin() + index, normal_dirty_.begin() + subtree_ends_[index], 1);
+        std::fill(bounds_dirty_.begin() + index, bounds_dirty_.begin() + subtree_ends_[index], 1);
+        MarkBoundsDirty(index);
+
+        first_dirty_ = std::min(first_dirty_, index);
+    }
+
+    /**
+     * Mark the bounds of a node and of its ancestors, which contain them.
+     */
+    void MarkBoundsDirty(size_t index) {
+        bounds_dirty_[index] = 1;
+        for (auto i = parents_[index]; i != kNoParent && !bounds_dirty_[i]; i = parents_[i]) {
+            bounds_dirty_[i] = 1;
+        }
+        bounds_stale_ = true;
+    }
+
+    /**
+     * Refit the marked bounding boxes, children before their parents. World matrices have to be up to date.
+     */
+    void UpdateBounds() {
+        for (auto i = parents_.size(); i-- > 0;) {
+            if (!bounds_dirty_[i]) {
+                continue;
+            }
+
+            bounds_[i] = local_bounds_[i].Transform(worlds_[i]);
+            for (auto child = i + 1; child < subtree_ends_[i]; child = subtree_ends_[child]) {
+                bounds_[i].Add(bounds_[child]);
+            }
+            bounds_dirty_[i] = 0;
+        }
+
+        bounds_stale_ = false;
+    }
+
+    /**
+     * Recompute the world transform of a node whose parent is up to date.
+     */
+    void UpdateWorld(size_t index) {
+        if (local_dirty_[index]) {
+            locals_[index] = glm::translate(translations_[index]) *
+                             glm::eulerAngleXYZ(rotations_[index].x, rotations_[index].y, rotations_[index].z) *
+                             glm::scale(scales_[index]);
+            local_dirty_[index] = 0;
+        }
+
+        auto parent = parents_[index];
+        worlds_[index] = parent == kNoParent ? locals_[index] : worlds_[parent] * locals_[index];
+        world_dirty_[index] = 0;
+    }
+
+    /**
+     * Recompute the world transform of a node and of its stale ancestors, top-down.
+     */
+    void UpdatePath(size_t index) {
+        path_.clear();
+        for (auto i = int32_t(index); i != kNoParent && world_dirty_[i]; i = parents_[i]) {
+            path_.push_back(size_t(i));
+        }
+
+        for (auto it = path_.rbegin(); it != path_.rend(); ++it) {
+            UpdateWorld(*it);
+        }
+    }
+};
+
+#endif // MODELS_TRANSFORMS_H_
@@ -0,0 +1,279 @@
+#ifndef MODELS_VERTEX_FORMAT_H_
+#define MODELS_VERTEX_FORMAT_H_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include "../shaders/shader.h"
+
+const glm::vec3 kDefaultMeshNormal = glm::vec3(0.0f, 0.0f, 1.0f);
+const glm::vec2 kDefaultMeshUV = glm::vec2(0.0f, 0.0f);
+const glm::vec3 kDefaultMeshTangent = glm::vec3(1.0f, 0.0f, 0.0f);
+const glm::vec3 kDefaultMeshBitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+
+/**
+ * Vertex as loaded, kept on the CPU for picking and editing; the GPU copy is encoded by a VertexLayout.
+ */
+struct MeshVertex {
+    [[maybe_unused]] glm::vec3 position;
+    [[maybe_unused]] glm::vec2 uv;
+    [[maybe_unused]] glm::vec3 normal;
+    [[maybe_unused]] glm::vec3 tangent;
+    [[maybe_unused]] glm::vec3 bitangent;
+
+    explicit MeshVertex(glm::vec3 position)
+        : position(position), uv(kDefaultMeshUV), normal(kDefaultMeshNormal), tangent(kDefaultMeshTangent),
+          bitangent(kDefaultMeshBitangent) {}
+};
+
+/**
+ * Bounds of quantized positions: position = min + encoded * extent, with encoded in [0, 1].
+ */
+struct VertexQuantization {
+    glm::vec3 min{0.0f};
+    glm::vec3 extent{1.0f};
+};
+
+/**
+ * One glVertexAttribPointer() call of an attribute encoding.
+ */
+struct VertexAttribute {
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset; // within the encoding
+};
+
+/**
+ * @return unit vector mapped onto the octahedron and unfolded into [-1, 1]^2, decoded by decodeOctahedral() in GLSL
+ */
+inline glm::vec2 EncodeOctahedral(const glm::vec3 &v) {
+    auto sum = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (sum == 0.0f) {
+        return glm::vec2(0.0f); // decodes to +z
+    }
+
+    auto p = glm::vec2(v.x, v.y) / sum;
+    if (v.z < 0.0f) {
+        auto sign = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+    }
+    return p;
+}
+
+// attribute encodings: kSize bytes written by Encode() and read back by the kAttributes pointers
+
+struct PositionFloat3 {
+    static constexpr size_t kSize = 12;
+    static constexpr std::array<VertexAttribute, 1> kAttributes = {{{0, 3, GL_FLOAT, GL_FALSE, 0}}};
+    static constexpr bool kIsPosition = true;
+    static constexpr bool kQuantizesPositions = false;
+    static constexpr uint32_t kShaderFeatures = 0;
+
+    static void Encode(const MeshVertex &vertex, const VertexQuantization &, uint8_t *out) {
+        std::memcpy(out, &vertex.position, kSize);
+    }
+};
+
+/**
+ * Position as 16-bit fractions of the mesh bounds, the bounds are applied by the model matrix.
+ */
+struct PositionUnorm16 {
+    static constexpr size_t kSize = 8; // padded to 4-byte alignment
+    static constexpr std::array<VertexAttribute, 1> kAttributes = {{{0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0}}};
+    static constexpr bool kIsPosition = true;
+    static constexpr bool kQuantizesPositions = true;
+    static constexpr uint32_t kShaderFeatures = 0;
+
+    static void Encode(const MeshVertex &vertex, const VertexQuantization &quantization, uint8_t *out) {
+        auto fraction = glm::clamp((vertex.position - quantization.min) / quantization.extent, 0.0f, 1.0f);
+        uint16_t values[4] = {
+            glm::packUnorm1x16(fraction.x), glm::packUnorm1x16(fraction.y), glm::packUnorm1x16(fraction.z), 0};
+        std::memcpy(out, values, kSize);
+    }
+};
+
+struct UvFloat2 {
+    static constexpr size_t kSize = 8;
+    static constexpr std::array<VertexAttribute, 1> kAttributes = {{{1, 2, GL_FLOAT, GL_FALSE, 0}}};
+    static constexpr bool kIsPosition = false;
+    static constexpr bool kQuantizesPositions = false;
+    static constexpr uint32_t kShaderFeatures = 0;
+
+    static void Encode(const MeshVertex &vertex, const VertexQuantization &, uint8_t *out) {
+        std::memcpy(out, &vertex.uv, kSize);
+    }
+};
+
+/**
+ * Texture coordinates as half floats, precise to 1/2048 of a texture within the first repeat and to 1/1024 up to
+ * 2 repeats.
+ */
+struct UvHalf2 {
+    static constexpr size_t kSize = 4;
+    static constexpr std::array<VertexAttribute, 1> kAttributes = {{{1, 2, GL_HALF_FLOAT, GL_FALSE, 0}}};
+    static constexpr bool kIsPosition = false;
+    static constexpr bool kQuantizesPositions = false;
+    static constexpr uint32_t kShaderFeatures = 0;
+
+    static void Encode(const MeshVertex &vertex, const VertexQuantization &, uint8_t *out) {
+        uint16_t values[2] = {glm::packHalf1x16(vertex.uv.x), glm::packHalf1x16(vertex.uv.y)};
+        std::memcpy(out, values, kSize);
+    }
+};
+
+/**
+ * Normal, tangent and bitangent as three float vectors.
+ */
+struct TangentFrameFloat {
+    static constexpr size_t kSize = 36;
+    static constexpr std::array<VertexAttribute, 3> kAttributes = {{
+        {2, 3, GL_FLOAT, GL_FALSE, 0},
+        {3, 3, GL_FLOAT, GL_FALSE, 12},
+        {4, 3, GL_FLOAT, GL_FALSE, 24},
+    }};
+    static constexpr bool kIsPosition = false;
+    static constexpr bool kQuantizesPositions = false;
+    static constexpr uint32_t kShaderFeatures = 0;
+
+    static void Encode(const MeshVertex &vertex, const VertexQuantization &, uint8_t *out) {
+        std::memcpy(out, &vertex.normal, 12);
+        std::memcpy(out + 12, &vertex.tangent, 12);
+        std::memcpy(out + 24, &vertex.bitangent, 12);
+    }
+};
+
+/**
+ * Octahedral normal in 16-bit snorms, octahedral tangent and the bitangent's handedness in 8-bit snorms; the shaders
+ * decode them under PACKED_NORMALS and rebuild the bitangent as sign * cross(normal, tangent).
+ */
+struct TangentFrameOctahedral {
+    static constexpr size_t kSize = 8;
+    static constexpr std::array<VertexAttribute, 2> kAttributes = {{
+        {2, 2, GL_SHORT, GL_TRUE, 0},
+        {3, 4, GL_BYTE, GL_TRUE, 4},
+    }};
+    static constexpr bool kIsPosition = false;
+    static constexpr bool kQuantizesPositions = false;
+    static constexpr uint32_t kShaderFeatures = SHADER_FEATURE_PACKED_NORMALS;
+
+    static void Encode(const MeshVertex &vertex, const VertexQuantization &, uint8_t *out) {
+        auto normal = EncodeOctahedral(vertex.normal);
+        auto tangent = EncodeOctahedral(vertex.tangent);
+        auto sign = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f ? -1.0f : 1.0f;
+
+        uint16_t normal_values[2] = {glm::packSnorm1x16(normal.x), glm::packSnorm1x16(normal.y)};
+        uint8_t tangent_values[4] = {
+            glm::packSnorm1x8(tangent.x), glm::packSnorm1x8(tangent.y), glm::packSnorm1x8(sign), 0};
+        std::memcpy(out, normal_values, 4);
+        std::memcpy(out + 4, tangent_values, 4);
+    }
+};
+
+/**
+ * Interleaved vertex format of attribute encodings, in order: stride, encoder and attribute pointers are all derived
+ * from the encodings at compile time.
+ */
+template <typename... Attributes> struct VertexFormat {
+    static constexpr size_t kStride = (Attributes::kSize + ...);
+    static constexpr uint32_t kShaderFeatures = (Attributes::kShaderFeatures | ...);
+    static constexpr bool kQuantizesPositions = (Attributes::kQuantizesPositions || ...);
+
+    static void Encode(const MeshVertex *vertices,
+                       size_t n_vertices,
+                       const VertexQuantization &quantization,
+                       uint8_t *out) {
+        for (size_t i = 0; i < n_vertices; ++i, out += kStride) {
+            size_t offset = 0;
+            ((Attributes::Encode(vertices[i], quantization, out + offset), offset += Attributes::kSize), ...);
+        }
+    }
+
+    /**
+     * Point the attributes of the bound vertex array at the bound GL_ARRAY_BUFFER.
+     *
+     * @param positions_only only the position attribute, for depth-only vertex arrays
+     */
+    static void SetAttributes(bool positions_only) {
+        size_t offset = 0;
+        ((SetAttributePointers<Attributes>(positions_only, offset), offset += Attributes::kSize), ...);
+    }
+
+private:
+    template <typename Attribute> static void SetAttributePointers(bool positions_only, size_t offset) {
+        if (positions_only && !Attribute::kIsPosition) {
+            return;
+        }
+
+        for (const auto &attribute : Attribute::kAttributes) {
+            glVertexAttribPointer(attribute.location,
+                                  attribute.size,
+                                  attribute.type,
+                                  attribute.normalized,
+                                  GLsizei(kStride),
+                                  (GLvoid *)(offset + attribute.offset));
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+};
+
+using FloatVertexFormat = VertexFormat<PositionFloat3, UvFloat2, TangentFrameFloat>;
+using PackedVertexFormat = VertexFormat<PositionFloat3, UvHalf2, TangentFrameOctahedral>;
+using QuantizedVertexFormat = VertexFormat<PositionUnorm16, UvHalf2, TangentFrameOctahedral>;
+
+static_assert(FloatVertexFormat::kStride == sizeof(MeshVertex));
+static_assert(PackedVertexFormat::kStride == 24);
+static_assert(QuantizedVertexFormat::kStride == 20);
+
+/**
+ * Vertex format chosen at run time.
+ */
+struct VertexLayout {
+    const char *name;
+    size_t stride;
+    uint32_t shader_features; // SHADER_FEATURE_* flags the vertex shaders need to decode the format
+    bool quantizes_positions; // positions are fractions of the mesh bounds
+    void (*encode)(const MeshVertex *, size_t, const VertexQuantization &, uint8_t *);
+    void (*set_attributes)(bool positions_only);
+};
+
+template <typename Format> constexpr VertexLayout MakeVertexLayout(const char *name) {
+    return VertexLayout{
+        .name = name,
+        .stride = Format::kStride,
+        .shader_features = Format::kShaderFeatures,
+        .quantizes_positions = Format::kQuantizesPositions,
+        .encode = &Format::Encode,
+        .set_attributes = &Format::SetAttributes,
+    };
+}
+
+inline const VertexLayout kVertexLayouts[] = {
+    MakeVertexLayout<FloatVertexFormat>("float"),
+    MakeVertexLayout<PackedVertexFormat>("packed"),
+    MakeVertexLayout<QuantizedVertexFormat>("quantized"),
+};
+
+/**
+ * @return layout of the given name, nullptr if there is none
+ */
+inline const VertexLayout *FindVertexLayout(const std::string &name) {
+    for (const auto &layout : kVertexLayouts) {
+        if (name == layout.name) {
+            return &layout;
+        }
+    }
+    return nullptr;
+}
+
+#endif // MODELS_VERTEX_FORMAT_H_
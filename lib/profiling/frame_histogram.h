@@ -0,0 +1,158 @@
+#ifndef LIB_PROFILING_FRAME_HISTOGRAM_H_
+#define LIB_PROFILING_FRAME_HISTOGRAM_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#define FRAME_HISTOGRAM_MIN_TIME 1e-6         // seconds, lower edge of the first bucket
+#define FRAME_HISTOGRAM_OCTAVES 24            // covers 1 us to ~16.7 s
+#define FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE 32 // ~1.1% relative error on percentiles
+
+/**
+ * Streaming frame-time statistics over a rolling window, in fixed memory.
+ *
+ * Samples go into logarithmically spaced buckets, so percentiles keep the same relative precision from sub-millisecond
+ * to multi-second frames. The window holds at most max_samples frames, and at most window_duration seconds of them.
+ * Adding a sample evicts expired ones, both are O(1) amortized; percentile queries scan the buckets.
+ */
+class FrameHistogram {
+public:
+    explicit FrameHistogram(size_t max_samples, double window_duration = std::numeric_limits<double>::infinity())
+        : samples_(std::max(max_samples, size_t(1))), window_duration_(window_duration) {
+        Reset();
+    }
+
+    void Reset() {
+        buckets_.fill(0);
+        head_ = count_ = 0;
+        sum_ = sum_squares_ = 0;
+        max_ = 0;
+        max_stale_ = false;
+    }
+
+    /**
+     * @param frame_time seconds
+     */
+    void Add(double frame_time) {
+        if (count_ == samples_.size()) {
+            EvictOldest();
+        }
+
+        samples_[(head_ + count_) % samples_.size()] = frame_time;
+        ++count_;
+
+        ++buckets_[GetBucket(frame_time)];
+        sum_ += frame_time;
+        sum_squares_ += frame_time * frame_time;
+        max_ = std::max(max_, frame_time);
+
+        while (count_ > 1 && sum_ > window_duration_) {
+            EvictOldest();
+        }
+    }
+
+    [[nodiscard]] size_t GetCount() const { return count_; }
+
+    /**
+     * @return seconds covered by the window
+     */
+    [[nodiscard]] double GetDuration() const { return sum_; }
+
+    [[nodiscard]] double GetFramesPerSecond() const { return sum_ > 0 ? double(count_) / sum_ : 0.0; }
+
+    [[nodiscard]] double GetMean() const { return count_ > 0 ? sum_ / double(count_) : 0.0; }
+
+    [[nodiscard]] double GetVariance() const {
+        if (count_ == 0) {
+            return 0.0;
+        }
+
+        auto mean = GetMean();
+        return std::max(sum_squares_ / double(count_) - mean * mean, 0.0); // clamp rounding from the rolling sums
+    }
+
+    /**
+     * @return exact longest frame time in the window, rescanned only after the longest one is evicted
+     */
+    [[nodiscard]] double GetMax() const {
+        if (max_stale_) {
+            max_ = 0;
+            for (size_t i = 0; i < count_; ++i) {
+                max_ = std::max(max_, samples_[(head_ + i) % samples_.size()]);
+            }
+            max_stale_ = false;
+        }
+
+        return max_;
+    }
+
+    /**
+     * @param percentile in range [0, 100]
+     * @return nearest-rank percentile, as the geometric center of its bucket
+     */
+    [[nodiscard]] double GetPercentile(double percentile) const {
+        if (count_ == 0) {
+            return 0.0;
+        }
+
+        auto rank = std::clamp(size_t(std::ceil(percentile / 100.0 * double(count_))), size_t(1), count_);
+
+        size_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                return GetBucketCenter(i);
+            }
+        }
+
+        return GetBucketCenter(buckets_.size() - 1);
+    }
+
+private:
+    static constexpr size_t kBuckets = FRAME_HISTOGRAM_OCTAVES * FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE;
+
+    std::array<uint32_t, kBuckets> buckets_{};
+
+    std::vector<double> samples_; // ring buffer of the window, allocated once
+    size_t head_ = 0, count_ = 0;
+
+    double window_duration_;
+    double sum_ = 0, sum_squares_ = 0;
+
+    mutable double max_ = 0;
+    mutable bool max_stale_ = false;
+
+    void EvictOldest() {
+        auto frame_time = samples_[head_];
+        head_ = (head_ + 1) % samples_.size();
+        --count_;
+
+        --buckets_[GetBucket(frame_time)];
+        sum_ -= frame_time;
+        sum_squares_ -= frame_time * frame_time;
+        max_stale_ = max_stale_ || frame_time >= max_;
+
+        if (count_ == 0) {
+            sum_ = sum_squares_ = 0; // drop accumulated rounding error
+        }
+    }
+
+    static size_t GetBucket(double frame_time) {
+        if (!(frame_time > FRAME_HISTOGRAM_MIN_TIME)) {
+            return 0;
+        }
+
+        auto bucket = std::log2(frame_time / FRAME_HISTOGRAM_MIN_TIME) * FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE;
+        return std::min(size_t(bucket), kBuckets - 1);
+    }
+
+    static double GetBucketCenter(size_t bucket) {
+        return FRAME_HISTOGRAM_MIN_TIME * std::exp2((double(bucket) + 0.5) / FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE);
+    }
+};
+
+#endif // LIB_PROFILING_FRAME_HISTOGRAM_H_
@@ -0,0 +1,419 @@
+#ifndef LIB_PROFILING_GL_COUNTERS_H_
+#define LIB_PROFILING_GL_COUNTERS_H_
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+/**
+ * GL calls and bytes counted by the GlCallCounters.
+ */
+struct GlCallCounts {
+    size_t draw_calls = 0;
+    size_t triangles = 0;
+    size_t state_changes = 0;   // program, vertex array, texture, buffer, framebuffer binds and capability toggles
+    size_t uniform_updates = 0; // glUniform* calls
+    size_t buffer_uploads = 0, buffer_bytes_uploaded = 0;
+    size_t texture_uploads = 0, texture_bytes_uploaded = 0;
+    size_t buffer_bytes_read = 0; // glGetBufferSubData
+
+    GlCallCounts &operator+=(const GlCallCounts &other) {
+        draw_calls += other.draw_calls;
+        triangles += other.triangles;
+        state_changes += other.state_changes;
+        uniform_updates += other.uniform_updates;
+        buffer_uploads += other.buffer_uploads;
+        buffer_bytes_uploaded += other.buffer_bytes_uploaded;
+        texture_uploads += other.texture_uploads;
+        texture_bytes_uploaded += other.texture_bytes_uploaded;
+        buffer_bytes_read += other.buffer_bytes_read;
+        return *this;
+    }
+};
+
+/**
+ * Opt-in GL call counting by swapping glad's function pointers for counting wrappers.
+ *
+ * Every glad call site, including the GlStateCache, is counted without changes; calls made through other loaders
+ * (the ImGui backend) are not. Costs one indirect call per counted function once installed, nothing otherwise.
+ */
+class GlCallCounters {
+public:
+    static GlCallCounters &GetInstance() {
+        static GlCallCounters instance;
+        return instance;
+    }
+
+    /**
+     * Wrap the loaded glad functions, must be called after gladLoadGL().
+     */
+    void Install() {
+        if (installed_) {
+            return;
+        }
+
+#define GL_COUNTERS_HOOK(name)                                                                                         \
+    real_.name = glad_gl##name;                                                                                        \
+    glad_gl##name = name;
+
+        GL_COUNTERS_HOOK(DrawArrays)
+        GL_COUNTERS_HOOK(DrawElements)
+        GL_COUNTERS_HOOK(DrawArraysInstanced)
+        GL_COUNTERS_HOOK(DrawElementsInstanced)
+
+        GL_COUNTERS_HOOK(UseProgram)
+        GL_COUNTERS_HOOK(BindVertexArray)
+        GL_COUNTERS_HOOK(BindTexture)
+        GL_COUNTERS_HOOK(ActiveTexture)
+        GL_COUNTERS_HOOK(BindBuffer)
+        GL_COUNTERS_HOOK(BindBufferBase)
+        GL_COUNTERS_HOOK(BindBufferRange)
+        GL_COUNTERS_HOOK(BindFramebuffer)
+        GL_COUNTERS_HOOK(Enable)
+        GL_COUNTERS_HOOK(Disable)
+
+        GL_COUNTERS_HOOK(Uniform1f)
+        GL_COUNTERS_HOOK(Uniform1i)
+        GL_COUNTERS_HOOK(Uniform2fv)
+        GL_COUNTERS_HOOK(Uniform3fv)
+        GL_COUNTERS_HOOK(Uniform4fv)
+        GL_COUNTERS_HOOK(UniformMatrix3fv)
+        GL_COUNTERS_HOOK(UniformMatrix4fv)
+
+        GL_COUNTERS_HOOK(BufferData)
+        GL_COUNTERS_HOOK(BufferSubData)
+        GL_COUNTERS_HOOK(TexImage2D)
+        GL_COUNTERS_HOOK(TexImage3D)
+        GL_COUNTERS_HOOK(TexSubImage2D)
+        GL_COUNTERS_HOOK(TexSubImage3D)
+        GL_COUNTERS_HOOK(GetBufferSubData)
+
+#undef GL_COUNTERS_HOOK
+
+        installed_ = true;
+    }
+
+    [[nodiscard]] bool IsInstalled() const { return installed_; }
+
+    /**
+     * Start counting a new frame, the counts of the finished one move to GetLastFrameCounts().
+     */
+    void BeginFrame() {
+        last_frame_ = counts_;
+        totals_ += counts_;
+        counts_ = GlCallCounts();
+    }
+
+    [[nodiscard]] const GlCallCounts &GetLastFrameCounts() const { return last_frame_; }
+
+    /**
+     * @return counts summed over all finished frames since ResetTotals()
+     */
+    [[nodiscard]] const GlCallCounts &GetTotals() const { return totals_; }
+
+    void ResetTotals() { totals_ = GlCallCounts(); }
+
+private:
+    struct {
+        PFNGLDRAWARRAYSPROC DrawArrays;
+        PFNGLDRAWELEMENTSPROC DrawElements;
+        PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+        PFNGLDRAWELEMENTSINSTANCEDPROC DrawElementsInstanced;
+
+        PFNGLUSEPROGRAMPROC UseProgram;
+        PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+        PFNGLBINDTEXTUREPROC BindTexture;
+        PFNGLACTIVETEXTUREPROC ActiveTexture;
+        PFNGLBINDBUFFERPROC BindBuffer;
+        PFNGLBINDBUFFERBASEPROC BindBufferBase;
+        PFNGLBINDBUFFERRANGEPROC BindBufferRange;
+        PFNGLBINDFRAMEBUFFERPROC BindFramebuffer;
+        PFNGLENABLEPROC Enable;
+        PFNGLDISABLEPROC Disable;
+
+        PFNGLUNIFORM1FPROC Uniform1f;
+        PFNGLUNIFORM1IPROC Uniform1i;
+        PFNGLUNIFORM2FVPROC Uniform2fv;
+        PFNGLUNIFORM3FVPROC Uniform3fv;
+        PFNGLUNIFORM4FVPROC Uniform4fv;
+        PFNGLUNIFORMMATRIX3FVPROC UniformMatrix3fv;
+        PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+
+        PFNGLBUFFERDATAPROC BufferData;
+        PFNGLBUFFERSUBDATAPROC BufferSubData;
+        PFNGLTEXIMAGE2DPROC TexImage2D;
+        PFNGLTEXIMAGE3DPROC TexImage3D;
+        PFNGLTEXSUBIMAGE2DPROC TexSubImage2D;
+        PFNGLTEXSUBIMAGE3DPROC TexSubImage3D;
+        PFNGLGETBUFFERSUBDATAPROC GetBufferSubData;
+    } real_{};
+
+    bool installed_ = false;
+
+    GlCallCounts counts_, last_frame_, totals_;
+
+    GlCallCounters() = default;
+
+    static GlCallCounts &Counts() { return GetInstance().counts_; }
+
+    static decltype(real_) &Real() { return GetInstance().real_; }
+
+    static size_t CountTriangles(GLenum mode, GLsizei count) {
+        switch (mode) {
+        case GL_TRIANGLES:
+            return size_t(count) / 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+            return count > 2 ? size_t(count) - 2 : 0;
+        default:
+            return 0;
+        }
+    }
+
+    /**
+     * @return bytes of client pixel data, assuming tightly packed rows
+     */
+    static size_t GetPixelDataSize(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type) {
+        size_t components;
+        switch (format) {
+        case GL_RED:
+        case GL_DEPTH_COMPONENT:
+        case GL_STENCIL_INDEX:
+            components = 1;
+            break;
+        case GL_RG:
+        case GL_DEPTH_STENCIL:
+            components = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+            components = 3;
+            break;
+        default:
+            components = 4;
+            break;
+        }
+
+        size_t component_size;
+        switch (type) {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE:
+            component_size = 1;
+            break;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:
+            component_size = 2;
+            break;
+        default:
+            component_size = 4;
+            break;
+        }
+
+        return size_t(width) * size_t(height) * size_t(depth) * components * component_size;
+    }
+
+    // draws
+
+    static void APIENTRY DrawArrays(GLenum mode, GLint first, GLsizei count) {
+        ++Counts().draw_calls;
+        Counts().triangles += CountTriangles(mode, count);
+        Real().DrawArrays(mode, first, count);
+    }
+
+    static void APIENTRY DrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) {
+        ++Counts().draw_calls;
+        Counts().triangles += CountTriangles(mode, count);
+        Real().DrawElements(mode, count, type, indices);
+    }
+
+    static void APIENTRY DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count) {
+        ++Counts().draw_calls;
+        Counts().triangles += CountTriangles(mode, count) * size_t(instance_count);
+        Real().DrawArraysInstanced(mode, first, count, instance_count);
+    }
+
+    static void APIENTRY
+    DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instance_count) {
+        ++Counts().draw_calls;
+        Counts().triangles += CountTriangles(mode, count) * size_t(instance_count);
+        Real().DrawElementsInstanced(mode, count, type, indices, instance_count);
+    }
+
+    // state changes
+
+    static void APIENTRY UseProgram(GLuint program) {
+        ++Counts().state_changes;
+        Real().UseProgram(program);
+    }
+
+    static void APIENTRY BindVertexArray(GLuint array) {
+        ++Counts().state_changes;
+        Real().BindVertexArray(array);
+    }
+
+    static void APIENTRY BindTexture(GLenum target, GLuint texture) {
+        ++Counts().state_changes;
+        Real().BindTexture(target, texture);
+    }
+
+    static void APIENTRY ActiveTexture(GLenum texture) {
+        ++Counts().state_changes;
+        Real().ActiveTexture(texture);
+    }
+
+    static void APIENTRY BindBuffer(GLenum target, GLuint buffer) {
+        ++Counts().state_changes;
+        Real().BindBuffer(target, buffer);
+    }
+
+    static void APIENTRY BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+        ++Counts().state_changes;
+        Real().BindBufferBase(target, index, buffer);
+    }
+
+    static void APIENTRY BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        ++Counts().state_changes;
+        Real().BindBufferRange(target, index, buffer, offset, size);
+    }
+
+    static void APIENTRY BindFramebuffer(GLenum target, GLuint framebuffer) {
+        ++Counts().state_changes;
+        Real().BindFramebuffer(target, framebuffer);
+    }
+
+    static void APIENTRY Enable(GLenum cap) {
+        ++Counts().state_changes;
+        Real().Enable(cap);
+    }
+
+    static void APIENTRY Disable(GLenum cap) {
+        ++Counts().state_changes;
+        Real().Disable(cap);
+    }
+
+    // uniforms
+
+    static void APIENTRY Uniform1f(GLint location, GLfloat v0) {
+        ++Counts().uniform_updates;
+        Real().Uniform1f(location, v0);
+    }
+
+    static void APIENTRY Uniform1i(GLint location, GLint v0) {
+        ++Counts().uniform_updates;
+        Real().Uniform1i(location, v0);
+    }
+
+    static void APIENTRY Uniform2fv(GLint location, GLsizei count, const GLfloat *value) {
+        ++Counts().uniform_updates;
+        Real().Uniform2fv(location, count, value);
+    }
+
+    static void APIENTRY Uniform3fv(GLint location, GLsizei count, const GLfloat *value) {
+        ++Counts().uniform_updates;
+        Real().Uniform3fv(location, count, value);
+    }
+
+    static void APIENTRY Uniform4fv(GLint location, GLsizei count, const GLfloat *value) {
+        ++Counts().uniform_updates;
+        Real().Uniform4fv(location, count, value);
+    }
+
+    static void APIENTRY UniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+        ++Counts().uniform_updates;
+        Real().UniformMatrix3fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+        ++Counts().uniform_updates;
+        Real().UniformMatrix4fv(location, count, transpose, value);
+    }
+
+    // uploads, allocations without data are not counted
+
+    static void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+        if (data != nullptr) {
+            ++Counts().buffer_uploads;
+            Counts().buffer_bytes_uploaded += size_t(size);
+        }
+        Real().BufferData(target, size, data, usage);
+    }
+
+    static void APIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+        ++Counts().buffer_uploads;
+        Counts().buffer_bytes_uploaded += size_t(size);
+        Real().BufferSubData(target, offset, size, data);
+    }
+
+    static void APIENTRY TexImage2D(GLenum target,
+                                    GLint level,
+                                    GLint internal_format,
+                                    GLsizei width,
+                                    GLsizei height,
+                                    GLint border,
+                                    GLenum format,
+                                    GLenum type,
+                                    const void *pixels) {
+        if (pixels != nullptr) {
+            ++Counts().texture_uploads;
+            Counts().texture_bytes_uploaded += GetPixelDataSize(width, height, 1, format, type);
+        }
+        Real().TexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+    }
+
+    static void APIENTRY TexImage3D(GLenum target,
+                                    GLint level,
+                                    GLint internal_format,
+                                    GLsizei width,
+                                    GLsizei height,
+                                    GLsizei depth,
+                                    GLint border,
+                                    GLenum format,
+                                    GLenum type,
+                                    const void *pixels) {
+        if (pixels != nullptr) {
+            ++Counts().texture_uploads;
+            Counts().texture_bytes_uploaded += GetPixelDataSize(width, height, depth, format, type);
+        }
+        Real().TexImage3D(target, level, internal_format, width, height, depth, border, format, type, pixels);
+    }
+
+    static void APIENTRY TexSubImage2D(GLenum target,
+                                       GLint level,
+                                       GLint x_offset,
+                                       GLint y_offset,
+                                       GLsizei width,
+                                       GLsizei height,
+                                       GLenum format,
+                                       GLenum type,
+                                       const void *pixels) {
+        ++Counts().texture_uploads;
+        Counts().texture_bytes_uploaded += GetPixelDataSize(width, height, 1, format, type);
+        Real().TexSubImage2D(target, level, x_offset, y_offset, width, height, format, type, pixels);
+    }
+
+    static void APIENTRY TexSubImage3D(GLenum target,
+                                       GLint level,
+                                       GLint x_offset,
+                                       GLint y_offset,
+                                       GLint z_offset,
+                                       GLsizei width,
+                                       GLsizei height,
+                                       GLsizei depth,
+                                       GLenum format,
+                                       GLenum type,
+                                       const void *pixels) {
+        ++Counts().texture_uploads;
+        Counts().texture_bytes_uploaded += GetPixelDataSize(width, height, depth, format, type);
+        Real().TexSubImage3D(target, level, x_offset, y_offset, z_offset, width, height, depth, format, type, pixels);
+    }
+
+    // readbacks
+
+    static void APIENTRY GetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void *data) {
+        Counts().buffer_bytes_read += size_t(size);
+        Real().GetBufferSubData(target, offset, size, data);
+    }
+};
+
+#endif // LIB_PROFILING_GL_COUNTERS_H_
@@ -0,0 +1,173 @@
+#ifndef LIB_PROFILING_GPU_TIMER_H_
+#define LIB_PROFILING_GPU_TIMER_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "../utils.h"
+
+#define GPU_TIMER_FRAMES 3 // frames in flight before a frame's queries are read back
+
+/**
+ * Per-pass GPU timing with timestamp queries.
+ *
+ * Each frame owns a pool of query objects. The pool of a frame is only read back when the frame slot comes around
+ * again, GPU_TIMER_FRAMES frames later, and only if the GPU has finished it, so reading results never stalls.
+ * Timestamp pairs are used instead of GL_TIME_ELAPSED since the latter cannot be nested, and passes like the lens
+ * scene pass contain Program::DrawTo.
+ */
+class GpuTimer {
+public:
+    /**
+     * Read back the oldest frame slot and start recording into it.
+     */
+    void BeginFrame() {
+        auto &frame = frames_[frame_index_];
+        Resolve(frame);
+
+        frame.scopes.clear();
+        frame.n_queries_used = 0;
+    }
+
+    void EndFrame() { frame_index_ = (frame_index_ + 1) % GPU_TIMER_FRAMES; }
+
+    /**
+     * @param name pass name, must outlive the frame (string literals)
+     * @return scope handle to be passed to End()
+     */
+    size_t Begin(const char *name) {
+        auto &frame = frames_[frame_index_];
+
+        Scope scope{.name = name, .begin_query = AcquireQuery(frame), .end_query = 0};
+        glQueryCounter(scope.begin_query, GL_TIMESTAMP);
+        frame.scopes.push_back(scope);
+
+        return frame.scopes.size() - 1;
+    }
+
+    void End(size_t scope) {
+        auto &frame = frames_[frame_index_];
+
+        frame.scopes[scope].end_query = AcquireQuery(frame);
+        glQueryCounter(frame.scopes[scope].end_query, GL_TIMESTAMP);
+    }
+
+    /**
+     * @return per-pass GPU time in milliseconds of the latest resolved frame, passes with the same name are summed
+     */
+    [[nodiscard]] const std::vector<std::pair<std::string, double>> &GetResults() const { return results_; }
+
+    /**
+     * @return per-pass GPU time in milliseconds, averaged over all resolved frames since the last ResetTotals()
+     */
+    [[nodiscard]] std::vector<std::pair<std::string, double>> GetAverages() const {
+        std::vector<std::pair<std::string, double>> averages;
+        for (const auto &[name, total] : totals_) {
+            averages.emplace_back(name, n_total_frames_ > 0 ? total / double(n_total_frames_) : 0.0);
+        }
+        return averages;
+    }
+
+    [[nodiscard]] size_t GetDroppedFrames() const { return n_dropped_frames_; }
+
+    void ResetTotals() {
+        totals_.clear();
+        n_total_frames_ = 0;
+        n_dropped_frames_ = 0;
+    }
+
+private:
+    struct Scope {
+        const char *name;
+        GLuint begin_query, end_query;
+    };
+
+    struct Frame {
+        std::vector<Scope> scopes;
+        std::vector<GLuint> queries;
+        size_t n_queries_used = 0;
+    };
+
+    Frame frames_[GPU_TIMER_FRAMES];
+    size_t frame_index_ = 0;
+
+    std::vector<std::pair<std::string, double>> results_;
+    std::vector<std::pair<std::string, double>> totals_;
+    size_t n_total_frames_ = 0, n_dropped_frames_ = 0;
+
+    static GLuint AcquireQuery(Frame &frame) {
+        if (frame.n_queries_used == frame.queries.size()) {
+            GLuint query;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+
+        return frame.queries[frame.n_queries_used++];
+    }
+
+    static void Accumulate(std::vector<std::pair<std::string, double>> &entries, const char *name, double value) {
+        for (auto &[entry_name, entry_value] : entries) {
+            if (entry_name == name) {
+                entry_value += value;
+                return;
+            }
+        }
+
+        entries.emplace_back(name, value);
+    }
+
+    void Resolve(const Frame &frame) {
+        if (frame.n_queries_used == 0) {
+            return;
+        }
+
+        // queries complete in submission order, checking the last one covers the whole frame
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame.queries[frame.n_queries_used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != GL_TRUE) {
+            ++n_dropped_frames_; // GPU is more than GPU_TIMER_FRAMES behind, don't wait for it
+            return;
+        }
+
+        results_.clear();
+        for (const auto &scope : frame.scopes) {
+            if (scope.end_query == 0) {
+                continue;
+            }
+
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(scope.begin_query, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(scope.end_query, GL_QUERY_RESULT, &end);
+
+            auto milliseconds = double(end - begin) / 1e6;
+            Accumulate(results_, scope.name, milliseconds);
+            Accumulate(totals_, scope.name, milliseconds);
+        }
+        ++n_total_frames_;
+
+        glCheckError();
+    }
+};
+
+/**
+ * Times the enclosing block on the GPU.
+ */
+class GpuTimerScope {
+public:
+    GpuTimerScope(GpuTimer &timer, const char *name) : timer_(timer), scope_(timer.Begin(name)) {}
+
+    ~GpuTimerScope() { timer_.End(scope_); }
+
+    GpuTimerScope(const GpuTimerScope &) = delete;
+    GpuTimerScope &operator=(const GpuTimerScope &) = delete;
+
+private:
+    GpuTimer &timer_;
+    size_t scope_;
+};
+
+#endif // LIB_PROFILING_GPU_TIMER_H_
@@ -0,0 +1,137 @@
+#ifndef LIB_PROFILING_OVERDRAW_COUNTER_H_
+#define LIB_PROFILING_OVERDRAW_COUNTER_H_
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "../utils.h"
+
+#define OVERDRAW_COUNTER_FRAMES 3 // frames in flight before a frame's queries are read back
+
+/**
+ * Samples that passed the depth test in the depth pre-pass and in the shading pass of a frame.
+ *
+ * The pre-pass draws front to back with GL_LESS, so it passes fewer samples than the shading pass, sorted by program
+ * and material, would shade without it; the shading pass with GL_EQUAL only shades the visible samples.
+ */
+struct OverdrawCounts {
+    GLuint64 prepass_samples = 0;
+    GLuint64 shaded_samples = 0;
+
+    /**
+     * @return lower bound of the samples whose shading the pre-pass removed, a frame drawn without the pre-pass would
+     *         also shade the occluded samples the front-to-back pre-pass already rejected
+     */
+    [[nodiscard]] GLuint64 GetRemoved() const {
+        return prepass_samples > shaded_samples ? prepass_samples - shaded_samples : 0;
+    }
+};
+
+/**
+ * Per-frame GL_SAMPLES_PASSED queries around the depth pre-pass and the shading pass of opaque geometry.
+ *
+ * Like GpuTimer, a frame's queries are only read back OVERDRAW_COUNTER_FRAMES frames later and only if available.
+ */
+class OverdrawCounter {
+public:
+    /**
+     * Read back the oldest frame slot and start recording into it.
+     */
+    void BeginFrame() {
+        auto &frame = frames_[frame_index_];
+        Resolve(frame);
+
+        frame.passes.clear();
+        frame.n_queries_used = 0;
+    }
+
+    void EndFrame() { frame_index_ = (frame_index_ + 1) % OVERDRAW_COUNTER_FRAMES; }
+
+    /**
+     * Start counting samples of a pass, passes cannot be nested.
+     *
+     * @param prepass true for the depth pre-pass, false for the shading pass
+     */
+    void Begin(bool prepass) {
+        auto &frame = frames_[frame_index_];
+
+        auto query = AcquireQuery(frame);
+        glBeginQuery(GL_SAMPLES_PASSED, query);
+        frame.passes.push_back(Pass{.query = query, .prepass = prepass});
+    }
+
+    void End() { glEndQuery(GL_SAMPLES_PASSED); }
+
+    /**
+     * @return counts of the latest resolved frame
+     */
+    [[nodiscard]] const OverdrawCounts &GetLastFrameCounts() const { return last_frame_; }
+
+    /**
+     * @return counts summed over all resolved frames since ResetTotals()
+     */
+    [[nodiscard]] const OverdrawCounts &GetTotals() const { return totals_; }
+
+    [[nodiscard]] size_t GetTotalFrames() const { return n_total_frames_; }
+
+    void ResetTotals() {
+        totals_ = OverdrawCounts();
+        n_total_frames_ = 0;
+    }
+
+private:
+    struct Pass {
+        GLuint query;
+        bool prepass;
+    };
+
+    struct Frame {
+        std::vector<Pass> passes;
+        std::vector<GLuint> queries;
+        size_t n_queries_used = 0;
+    };
+
+    Frame frames_[OVERDRAW_COUNTER_FRAMES];
+    size_t frame_index_ = 0;
+
+    OverdrawCounts last_frame_, totals_;
+    size_t n_total_frames_ = 0;
+
+    static GLuint AcquireQuery(Frame &frame) {
+        if (frame.n_queries_used == frame.queries.size()) {
+            GLuint query;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+
+        return frame.queries[frame.n_queries_used++];
+    }
+
+    void Resolve(const Frame &frame) {
+        if (frame.passes.empty()) {
+            return;
+        }
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame.passes.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != GL_TRUE) {
+            return; // GPU is more than OVERDRAW_COUNTER_FRAMES behind, don't wait for it
+        }
+
+        last_frame_ = OverdrawCounts();
+        for (const auto &pass : frame.passes) {
+            GLuint64 samples = 0;
+            glGetQueryObjectui64v(pass.query, GL_QUERY_RESULT, &samples);
+            (pass.prepass ? last_frame_.prepass_samples : last_frame_.shaded_samples) += samples;
+        }
+
+        totals_.prepass_samples += last_frame_.prepass_samples;
+        totals_.shaded_samples += last_frame_.shaded_samples;
+        ++n_total_frames_;
+
+        glCheckError();
+    }
+};
+
+#endif // LIB_PROFILING_OVERDRAW_COUNTER_H_
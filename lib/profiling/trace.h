@@ -0,0 +1,180 @@
+#ifndef LIB_PROFILING_TRACE_H_
+#define LIB_PROFILING_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * CPU scope profiler writing the Chrome trace-event format (chrome://tracing, Perfetto).
+ *
+ * Every thread records into its own buffer, so recording a scope takes no lock. Buffers are owned by the profiler and
+ * outlive their threads, they are written out once when the process exits.
+ */
+class TraceProfiler {
+public:
+    static TraceProfiler &GetInstance() {
+        static TraceProfiler instance;
+        return instance;
+    }
+
+    /**
+     * Start recording, the trace is written to output_path at exit.
+     */
+    void Enable(const std::string &output_path) {
+        output_path_ = output_path;
+        if (!enabled_.exchange(true, std::memory_order_relaxed)) {
+            std::atexit([] { GetInstance().Flush(); });
+        }
+    }
+
+    [[nodiscard]] bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @return microseconds since the profiler was created
+     */
+    [[nodiscard]] double GetTimestamp() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch_).count();
+    }
+
+    /**
+     * @param name event name, must outlive the profiler (string literals)
+     * @param detail optional "detail" argument, e.g. a file path
+     */
+    void Record(const char *name, std::string detail, double begin, double end) {
+        GetThreadBuffer().events.push_back(
+            Event{.name = name, .detail = std::move(detail), .begin = begin, .duration = end - begin});
+    }
+
+    void Flush() {
+        std::lock_guard lock(mutex_);
+        if (!enabled_.exchange(false, std::memory_order_relaxed)) {
+            return;
+        }
+
+        std::ofstream file(output_path_);
+        if (!file) {
+            std::cerr << "ERROR: Failed to open trace output " << output_path_ << std::endl;
+            return;
+        }
+
+        size_t n_events = 0;
+
+        file << std::fixed << std::setprecision(3); // default precision would round timestamps past a few seconds
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (const auto &buffer : buffers_) {
+            for (const auto &event : buffer->events) {
+                file << (n_events++ > 0 ? ",\n" : "\n");
+                file << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id << ",\"ts\":" << event.begin
+                     << ",\"dur\":" << event.duration << ",\"name\":";
+                WriteString(file, event.name);
+                if (!event.detail.empty()) {
+                    file << ",\"args\":{\"detail\":";
+                    WriteString(file, event.detail);
+                    file << "}";
+                }
+                file << "}";
+            }
+        }
+        file << "\n]}\n";
+
+        std::cout << "INFO: Trace with " << n_events << " events written to " << output_path_ << std::endl;
+    }
+
+private:
+    struct Event {
+        const char *name;
+        std::string detail;
+        double begin, duration; // microseconds
+    };
+
+    struct ThreadBuffer {
+        size_t thread_id;
+        std::vector<Event> events;
+    };
+
+    std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+    std::atomic<bool> enabled_ = false;
+    std::string output_path_;
+
+    std::mutex mutex_; // guards buffers_, not the buffers themselves
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+    TraceProfiler() = default;
+
+    ThreadBuffer &GetThreadBuffer() {
+        thread_local ThreadBuffer *buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard lock(mutex_);
+            buffers_.push_back(std::make_unique<ThreadBuffer>());
+            buffer = buffers_.back().get();
+            buffer->thread_id = buffers_.size();
+        }
+
+        return *buffer;
+    }
+
+    static void WriteString(std::ostream &out, const std::string &value) {
+        out << '"';
+        for (auto c : value) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (c == '\n') {
+                out << "\\n";
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+};
+
+/**
+ * Records the enclosing block as a complete event, costs a single relaxed load when tracing is disabled.
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char *name, const char *detail = nullptr) {
+        auto &profiler = TraceProfiler::GetInstance();
+        if (profiler.IsEnabled()) {
+            name_ = name;
+            detail_ = detail != nullptr ? detail : "";
+            begin_ = profiler.GetTimestamp();
+        }
+    }
+
+    ~TraceScope() {
+        if (name_ != nullptr) {
+            auto &profiler = TraceProfiler::GetInstance();
+            profiler.Record(name_, std::move(detail_), begin_, profiler.GetTimestamp());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name_ = nullptr;
+    std::string detail_;
+    double begin_ = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifndef DISABLE_TRACE
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_SCOPE_DETAIL(name, detail) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name, detail)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_DETAIL(name, detail)
+#endif
+
+#endif // LIB_PROFILING_TRACE_H_
@@ -5,12 +5,25 @@
 #include "imgui/backends/imgui_impl_glfw.h"
 #include "imgui/backends/imgui_impl_opengl3.h"
 
+#include "bench.h"
 #include "cameras/camera_fp.h"
+#include "gl_state.h"
+#include "headless.h"
 #include "models/scene.h"
+#include "profiling/frame_histogram.h"
+#include "profiling/gl_counters.h"
+#include "profiling/gpu_timer.h"
+#include "profiling/overdraw_counter.h"
+#include "profiling/trace.h"
+#include "replay.h"
+#include "shaders/draw_data.h"
+#include "shaders/light_grid.h"
 #include "shaders/shader.h"
 #include "utils.h"
 
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdlib>
 #include <glad/glad.h>
 #include <numeric>
 
@@ -19,6 +32,11 @@
 #define Z_NEAR 0.1f
 #define Z_FAR 100.0f
 
+#define BENCH_FRAME_TIME (1.0 / 60.0)
+
+#define FRAME_STATS_WINDOW 1.0       // seconds of frames shown in the stats window
+#define FRAME_STATS_MAX_SAMPLES 8192 // caps the window at high frame rates
+
 static const std::map<GLenum, glm::vec3> cube_map_faces = {
     {GL_TEXTURE_CUBE_MAP_POSITIVE_X, glm::vec3(1.0f, 0.0f, 0.0f)},
     {GL_TEXTURE_CUBE_MAP_NEGATIVE_X, glm::vec3(-1.0f, 0.0f, 0.0f)},
@@ -37,7 +55,7 @@ public:
 
         std::cout << "Current working directory: " << std::filesystem::current_path() << std::endl;
 
-        if (!InitializeWindow()) {
+        if (!(bench_.enabled ? InitializeHeadless() : InitializeWindow())) {
             DestroyWindow();
             return false;
         }
@@ -48,49 +66,157 @@ public:
             return false;
         }
 
-        InitializeImGui();
+        if (!bench_.enabled) {
+            InitializeImGui();
+        }
+
+        TrackValue("depth_prepass", &depth_prepass_);
+
+        return true;
+    }
+
+    /**
+     * Accepted arguments:
+     *   --bench                 render off-screen without a window and write frame-time statistics
+     *   --bench-frames <n>      number of recorded benchmark frames
+     *   --bench-output <path>   path of the JSON benchmark report
+     *   --trace <path>          record CPU scopes and write a Chrome trace to path at exit
+     *   --gl-counters           count GL calls and uploaded bytes per frame
+     *   --depth-prepass         draw opaque geometry depth-only before shading it
+     *   --vertex-format <name>  vertex layout of meshes: float, packed (default) or quantized
+     *   --no-mesh-optimization  keep the vertices and triangle order of model files, unwelded
+     *   --no-lod                draw meshes at full detail only, without generating levels of detail
+     *   --lod-cache <path>      directory of cached levels of detail, lod_cache by default
+     *   --no-lod-cache          always generate levels of detail
+     *   --program-cache <path>  directory of cached program binaries, program_cache by default
+     *   --no-program-cache      always compile shader programs
+     *   --record <path>         record per-frame input to a binary log
+     *   --replay <path>         replay a recorded input log, with its recorded frame steps, then exit
+     */
+    bool ParseCommandLine(int argc, char **argv) {
+        for (int i = 1; i < argc; ++i) {
+            auto arg = std::string(argv[i]);
+
+            if (arg == "--bench") {
+                bench_.enabled = true;
+            } else if (arg == "--bench-frames" && i + 1 < argc) {
+                char *end = nullptr;
+                bench_.frames = std::strtoul(argv[++i], &end, 10);
+                if (*end != '\0' || bench_.frames == 0) {
+                    std::cerr << "ERROR: Invalid frame count: " << argv[i] << std::endl;
+                    return false;
+                }
+            } else if (arg == "--bench-output" && i + 1 < argc) {
+                bench_.output_path = argv[++i];
+            } else if (arg == "--trace" && i + 1 < argc) {
+                TraceProfiler::GetInstance().Enable(argv[++i]);
+            } else if (arg == "--gl-counters") {
+                count_gl_calls_ = true;
+            } else if (arg == "--depth-prepass") {
+                depth_prepass_ = true;
+            } else if (arg == "--vertex-format" && i + 1 < argc) {
+                const auto *layout = FindVertexLayout(argv[++i]);
+                if (layout == nullptr) {
+                    std::cerr << "ERROR: Unknown vertex format: " << argv[i] << std::endl;
+                    return false;
+                }
+                Mesh::SetDefaultLayout(layout);
+            } else if (arg == "--no-mesh-optimization") {
+                Mesh::SetOptimizeOnLoad(false);
+            } else if (arg == "--no-lod") {
+                Mesh::SetGenerateLods(false);
+            } else if (arg == "--lod-cache" && i + 1 < argc) {
+                LodCache::GetInstance().SetDirectory(argv[++i]);
+            } else if (arg == "--no-lod-cache") {
+                LodCache::GetInstance().Disable();
+            } else if (arg == "--program-cache" && i + 1 < argc) {
+                ProgramBinaryCache::GetInstance().SetDirectory(argv[++i]);
+            } else if (arg == "--no-program-cache") {
+                ProgramBinaryCache::GetInstance().Disable();
+            } else if (arg == "--record" && i + 1 < argc) {
+                record_path_ = argv[++i];
+            } else if (arg == "--replay" && i + 1 < argc) {
+                replay_path_ = argv[++i];
+            } else {
+                std::cerr << "ERROR: Unknown argument: " << arg << std::endl;
+                std::cerr << "Usage: " << argv[0]
+                          << " [--bench] [--bench-frames <n>] [--bench-output <path>] [--trace <path>]"
+                          << " [--gl-counters] [--depth-prepass] [--vertex-format <float|packed|quantized>]"
+                          << " [--no-mesh-optimization] [--no-lod] [--lod-cache <path> | --no-lod-cache]"
+                          << " [--program-cache <path> | --no-program-cache]"
+                          << " [--record <path> | --replay <path>]" << std::endl;
+                return false;
+            }
+        }
+
+        if (!record_path_.empty() && (bench_.enabled || !replay_path_.empty())) {
+            std::cerr << "ERROR: --record cannot be combined with --bench or --replay" << std::endl;
+            return false;
+        }
 
         return true;
     }
 
     void Run() {
+        PrintProgramCacheSummary();
+
+        if (!StartInputLog()) {
+            return;
+        }
+
+        if (bench_.enabled) {
+            RunBenchmark();
+            input_log_.Close();
+            return;
+        }
+
         glfwSetWindowSize(window_, window_width_, window_height_);
 
         last_frame_clock_ = glfwGetTime();
         while (!glfwWindowShouldClose(window_)) {
             glfwPollEvents();
 
-            if (!io_->WantCaptureMouse) {
-                HandleKeyboardInput(last_frame_time_);
-                HandleMouseInput();
+            // escape to exit
+            if (glfwGetKey(window_, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                glfwSetWindowShouldClose(window_, true);
             }
 
             // statistics
 
-            current_frame_clock_ = glfwGetTime();
-            last_frame_time_ = current_frame_clock_ - last_frame_clock_;
-            last_frame_clock_ = current_frame_clock_;
-
-            frame_times.push_back(last_frame_time_);
-            total_frame_time += last_frame_time_;
-
-            if (total_frame_time > 1.0) {
-                auto frame_count = double(frame_times.size());
-                frame_per_sec = frame_count / total_frame_time;
-                frame_time_avg = total_frame_time / frame_count;
-                frame_time_var = std::accumulate(frame_times.begin(),
-                                                 frame_times.end(),
-                                                 0.0,
-                                                 [&](double sum, double x) {
-                                                     return sum + (x - frame_time_avg) * (x - frame_time_avg);
-                                                 }) /
-                                 frame_count;
-
-                frame_times.clear();
-                total_frame_time = 0;
+            auto frame_clock = glfwGetTime();
+            frame_stats_.Add(frame_clock - last_frame_clock_);
+
+            // input, the simulation only advances by the frame's recorded step so replays are deterministic
+
+            if (input_log_.IsReplaying()) {
+                if (!input_log_.ReplayFrame(input_)) {
+                    std::cout << "INFO: Input replay finished" << std::endl;
+                    break;
+                }
+            } else {
+                PollInput(frame_clock - last_frame_clock_);
             }
+            last_frame_clock_ = frame_clock;
+
+            last_frame_time_ = input_.frame_time;
+            current_frame_clock_ += last_frame_time_;
+
+            HandleInput();
 
-            Draw();
+            GlStateCache::GetInstance().BeginFrame();
+            GlCallCounters::GetInstance().BeginFrame();
+            RenderQueue::GetInstance().BeginFrame();
+            DrawDataRing::GetInstance().BeginFrame();
+            gpu_timer_.BeginFrame();
+            overdraw_counter_.BeginFrame();
+            {
+                TRACE_SCOPE("Program::Draw");
+                GpuTimerScope scope(gpu_timer_, "frame");
+                Draw();
+            }
+            overdraw_counter_.EndFrame();
+            gpu_timer_.EndFrame();
+            DrawDataRing::GetInstance().EndFrame();
 
             {
                 ImGui_ImplOpenGL3_NewFrame();
@@ -103,8 +229,18 @@ public:
                 ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
             }
 
+            // values edited through ImGui
+
+            if (input_log_.IsRecording()) {
+                input_log_.RecordFrame(input_);
+            } else if (input_log_.IsReplaying()) {
+                input_log_.ApplyChanges();
+            }
+
             glfwSwapBuffers(window_);
         }
+
+        input_log_.Close();
     }
 
 protected:
@@ -119,6 +255,13 @@ protected:
     GLFWwindow *window_ = nullptr;
     ImGuiIO *io_ = nullptr;
 
+    GLuint default_framebuffer_ = 0; // off-screen framebuffer when running headless
+
+    GpuTimer gpu_timer_;
+    OverdrawCounter overdraw_counter_;
+
+    bool depth_prepass_ = false; // see DrawOpaque()
+
     double last_frame_time_ = 0, current_frame_clock_ = 0;
 
     GLuint quad_vao_ = 0, quad_vbo_ = 0;
@@ -132,18 +275,33 @@ protected:
         auto aspect = (float)width / (float)height;
         auto projection_matrix = glm::perspective(glm::radians(fov), aspect, Z_NEAR, Z_FAR);
 
-        for (auto &shader : shaders_) {
-            shader->ConfigureCamera(camera_position, projection_matrix, view_matrix);
+        camera_uniforms_.Upload(CameraUniforms{
+            .projection_matrix = projection_matrix,
+            .view_matrix = view_matrix,
+            .camera_position = glm::vec4(camera_position, 1.0f),
+        });
+
+        if (lights_dirty_) {
+            lights_uniforms_.Upload(lights_);
+            lights_dirty_ = false;
         }
 
+        RenderQueue::GetInstance().SetViewMatrix(view_matrix);
+        RenderQueue::GetInstance().SetProjection(projection_matrix, float(height));
+
+        light_grid_.Build(view_matrix, projection_matrix, Z_NEAR, Z_FAR, width, height);
+        light_grid_.Upload();
+
         return projection_matrix;
     }
 
-    virtual void Draw() { DrawTo(0, window_width_, window_height_); }
+    virtual void Draw() { DrawTo(default_framebuffer_, window_width_, window_height_); }
 
     virtual void DrawTo(GLuint fbo) { DrawTo(fbo, window_width_, window_height_); }
 
     virtual void DrawTo(GLuint fbo, GLsizei viewport_width, GLsizei viewport_height) {
+        GpuTimerScope scope(gpu_timer_, "clear");
+
         glBindFramebuffer(GL_FRAMEBUFFER, fbo);
         glViewport(0, 0, viewport_width, viewport_height);
 
@@ -158,31 +316,179 @@ protected:
         glCheckError();
     }
 
+    /**
+     * Draw opaque scenes, each with its lit shader, through one render queue so their draws are sorted together. With
+     * the depth pre-pass enabled, the scenes are first drawn depth-only and then shaded with GL_EQUAL, so every sample
+     * is shaded once however the geometry overlaps.
+     *
+     * Shaders must compute gl_Position like depth.vert and declare it invariant.
+     */
+    void DrawOpaque(std::initializer_list<std::pair<Scene *, ShaderProgram *>> scenes) {
+        auto prepass = depth_prepass_ && depth_shader_ != nullptr && depth_shader_->IsReady();
+
+        auto &queue = RenderQueue::GetInstance();
+        queue.Clear();
+        for (const auto &[scene, shader] : scenes) {
+            scene->Enqueue(queue, shader, 0);
+        }
+
+        if (prepass) {
+            GpuTimerScope scope(gpu_timer_, "depth_prepass");
+            overdraw_counter_.Begin(true);
+
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+            depth_shader_->Use();
+            queue.SubmitDepth(depth_shader_);
+
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+
+            overdraw_counter_.End();
+        }
+
+        {
+            GpuTimerScope scope(gpu_timer_, "opaque");
+            overdraw_counter_.Begin(false);
+            queue.Submit();
+
+            overdraw_counter_.End();
+        }
+
+        if (prepass) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+
+        glCheckError();
+    }
+
     virtual void DrawImGui() {
         ImGui::Begin("Stats");
-        ImGui::Text("FPS: %.2f", frame_per_sec);
+        ImGui::Text("FPS: %.2f", frame_stats_.GetFramesPerSecond());
         ImGui::Text("Frame time: %.2f ms", last_frame_time_ * 1000);
-        ImGui::Text("Frame time avg: %.2f ms", frame_time_avg * 1000);
-        ImGui::Text("Frame time var: %.2f ms", frame_time_var * 1000);
+        ImGui::Text("Frame time avg: %.2f ms", frame_stats_.GetMean() * 1000);
+        ImGui::Text("Frame time std dev: %.2f ms", std::sqrt(frame_stats_.GetVariance()) * 1000);
+        ImGui::Text("Frame time p50/p95/p99: %.2f / %.2f / %.2f ms",
+                    frame_stats_.GetPercentile(50) * 1000,
+                    frame_stats_.GetPercentile(95) * 1000,
+                    frame_stats_.GetPercentile(99) * 1000);
+
+        if (ImGui::TreeNodeEx("GPU time", ImGuiTreeNodeFlags_DefaultOpen)) {
+            for (const auto &[name, milliseconds] : gpu_timer_.GetResults()) {
+                ImGui::Text("%s: %.3f ms", name.c_str(), milliseconds);
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("GL state")) {
+            const auto &counters = GlStateCache::GetInstance().GetLastFrameCounters();
+            ImGui::Text("Programs: %zu bound, %zu skipped", counters.program_binds, counters.program_skips);
+            ImGui::Text(
+                "Vertex arrays: %zu bound, %zu skipped", counters.vertex_array_binds, counters.vertex_array_skips);
+            ImGui::Text("Textures: %zu bound, %zu skipped", counters.texture_binds, counters.texture_skips);
+            ImGui::Text("Active texture: %zu changed, %zu skipped",
+                        counters.active_texture_changes,
+                        counters.active_texture_skips);
+            ImGui::TreePop();
+        }
+
+        auto &gl_calls = GlCallCounters::GetInstance();
+        if (gl_calls.IsInstalled() && ImGui::TreeNodeEx("GL calls", ImGuiTreeNodeFlags_DefaultOpen)) {
+            const auto &counts = gl_calls.GetLastFrameCounts();
+            ImGui::Text("Draw calls: %zu (%zu triangles)", counts.draw_calls, counts.triangles);
+            ImGui::Text("State changes: %zu", counts.state_changes);
+            ImGui::Text("Uniform updates: %zu", counts.uniform_updates);
+            ImGui::Text("Buffer uploads: %zu (%.1f KiB)",
+                        counts.buffer_uploads,
+                        double(counts.buffer_bytes_uploaded) / 1024);
+            ImGui::Text("Texture uploads: %zu (%.1f KiB)",
+                        counts.texture_uploads,
+                        double(counts.texture_bytes_uploaded) / 1024);
+            ImGui::Text("Buffer reads: %.1f KiB", double(counts.buffer_bytes_read) / 1024);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Overdraw")) {
+            ImGui::Checkbox("Depth pre-pass", &depth_prepass_);
+
+            const auto &counts = overdraw_counter_.GetLastFrameCounts();
+            ImGui::Text("Shaded samples: %llu", (unsigned long long)counts.shaded_samples);
+            if (counts.prepass_samples > 0) {
+                ImGui::Text("Removed by pre-pass: at least %llu (%.1f%%)",
+                            (unsigned long long)counts.GetRemoved(),
+                            100.0 * double(counts.GetRemoved()) / double(counts.prepass_samples));
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Culling")) {
+            auto &queue = RenderQueue::GetInstance();
+            auto culling_enabled = queue.IsCullingEnabled();
+            if (ImGui::Checkbox("Frustum culling", &culling_enabled)) {
+                queue.SetCullingEnabled(culling_enabled);
+            }
+
+            const auto &counters = queue.GetLastFrameCounters();
+            ImGui::Text("Meshes: %zu visible, %zu culled", counters.visible_meshes, counters.culled_meshes);
+            ImGui::Text("Subtrees culled: %zu, %zu frustum tests", counters.culled_subtrees, counters.frustum_tests);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Levels of detail")) {
+            auto &queue = RenderQueue::GetInstance();
+            auto lod_enabled = queue.IsLodEnabled();
+            if (ImGui::Checkbox("Simplify distant meshes", &lod_enabled)) {
+                queue.SetLodEnabled(lod_enabled);
+            }
+
+            const auto &stats = LodCache::GetInstance().GetStats();
+            ImGui::Text("Cache: %zu loaded, %zu generated", stats.hits, stats.misses);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Point lights")) {
+            const auto &stats = light_grid_.GetStats();
+            ImGui::Text("Lights: %zu visible of %zu", stats.visible_lights, stats.lights);
+            ImGui::Text("Cluster references: %zu, at most %zu in a cluster",
+                        stats.references,
+                        stats.max_cluster_lights);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Program cache")) {
+            const auto &stats = ProgramBinaryCache::GetInstance().GetStats();
+            ImGui::Text("Loaded: %zu (%.1f ms)", stats.hits, stats.load_seconds * 1000);
+            ImGui::Text("Compiled: %zu (%.1f ms), %zu entries rejected",
+                        stats.misses,
+                        stats.compile_seconds * 1000,
+                        stats.rejected);
+            ImGui::Text("Startup time saved: %.1f ms", stats.saved_seconds * 1000);
+            ImGui::TreePop();
+        }
+
         ImGui::End();
     }
 
     virtual void DrawEnvMap(glm::vec3 position) {
+        GpuTimerScope scope(gpu_timer_, "env_map");
+
         glBindFramebuffer(GL_FRAMEBUFFER, env_map_.name);
         glViewport(0, 0, ENV_MAP_SIZE, ENV_MAP_SIZE);
 
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, env_map_.name, 0);
-        DrawEnvMapFace(position, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, env_map_.name, 0);
-        DrawEnvMapFace(position, glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, env_map_.name, 0);
-        DrawEnvMapFace(position, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, env_map_.name, 0);
-        DrawEnvMapFace(position, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, env_map_.name, 0);
-        DrawEnvMapFace(position, glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, env_map_.name, 0);
-        DrawEnvMapFace(position, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        DrawEnvMapFaceTo(
+            GL_TEXTURE_CUBE_MAP_POSITIVE_X, position, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        DrawEnvMapFaceTo(
+            GL_TEXTURE_CUBE_MAP_NEGATIVE_X, position, glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        DrawEnvMapFaceTo(
+            GL_TEXTURE_CUBE_MAP_POSITIVE_Y, position, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        DrawEnvMapFaceTo(
+            GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, position, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+        DrawEnvMapFaceTo(
+            GL_TEXTURE_CUBE_MAP_POSITIVE_Z, position, glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        DrawEnvMapFaceTo(
+            GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, position, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
 
         glCheckError();
     }
@@ -195,6 +501,30 @@ protected:
         ConfigureShaders(position, ENV_MAP_SIZE, ENV_MAP_SIZE, 90, viewMatrix);
     }
 
+    /**
+     * @return cursor position of the frame in window coordinates, the window center when running headless
+     */
+    void GetCursorPos(double &x, double &y) const {
+        x = input_.cursor.x;
+        y = input_.cursor.y;
+    }
+
+    [[nodiscard]] bool IsMouseButtonPressed(int button) const {
+        switch (button) {
+        case GLFW_MOUSE_BUTTON_LEFT:
+            return input_.mouse_buttons & INPUT_BUTTON_LEFT;
+        case GLFW_MOUSE_BUTTON_RIGHT:
+            return input_.mouse_buttons & INPUT_BUTTON_RIGHT;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * Register a value edited through ImGui, so recorded sessions replay its changes. Call during Initialize().
+     */
+    template <typename T> void TrackValue(const std::string &name, T *value) { input_log_.Track(name, value); }
+
     virtual void HandleFramebufferSizeChange(int width, int height) {
         std::cout << "INFO: Resized window to " << width << "x" << height << std::endl;
         window_width_ = width;
@@ -214,33 +544,62 @@ protected:
             return;
         }
 
-        light_diffuses_[index] = diffuse;
-        light_directions_[index] = direction;
-        light_positions_[index] = position;
+        lights_.diffuses[index] = glm::vec4(diffuse, 0.0f);
+        lights_.directions[index] = glm::vec4(direction, 0.0f);
+        lights_.positions[index] = glm::vec4(position, 1.0f);
+        lights_dirty_ = true;
+    }
+
+    void SetLightCount(size_t n_lights) {
+        lights_.n_lights = GLint(n_lights);
+        lights_dirty_ = true;
 
-        for (auto shader : shaders_) {
-            shader->ConfigureLights(n_lights_, light_positions_, light_directions_, light_diffuses_);
-        }
+        ShaderProgram::SetLightCount(GLint(n_lights));
+    }
+
+    /**
+     * Add a point light, shaded through the clustered light grid and not limited to MAX_N_LIGHTS.
+     *
+     * @return index of the light, for SetPointLight(), or LightGrid::kNoLight if the grid is full
+     */
+    size_t AddPointLight(glm::vec3 position, float radius, glm::vec3 color) {
+        return light_grid_.AddLight(PointLight{.position = position, .radius = radius, .color = color});
+    }
+
+    void SetPointLight(size_t index, glm::vec3 position, float radius, glm::vec3 color) {
+        light_grid_.SetLight(index, PointLight{.position = position, .radius = radius, .color = color});
     }
 
-    void SetLightCount(size_t n_lights) { n_lights_ = GLint(n_lights); }
+    void ClearPointLights() { light_grid_.ClearLights(); }
 
 private:
     std::string window_title_;
 
+    BenchOptions bench_;
+    HeadlessContext headless_context_;
+    GLuint headless_color_rbo_ = 0, headless_depth_rbo_ = 0;
+
     GLuint env_map_fbo_;
     GLuint env_map_depth_rbo_;
 
-    GLint n_lights_ = 1;
-    glm::vec3 light_diffuses_[MAX_N_LIGHTS] = {glm::vec3(1.0f, 1.0f, 1.0f)};
-    glm::vec3 light_directions_[MAX_N_LIGHTS] = {glm::vec3(0, 0, 0)};
-    glm::vec3 light_positions_[MAX_N_LIGHTS] = {glm::vec3(0, 0, 0)};
+    UniformBuffer<CameraUniforms> camera_uniforms_;
+    UniformBuffer<LightsUniforms> lights_uniforms_;
+    LightGrid light_grid_;
+
+    LightsUniforms lights_{.diffuses = {glm::vec4(1.0f, 1.0f, 1.0f, 0.0f)}, .n_lights = 1};
+    bool lights_dirty_ = true; // uploaded with the next camera
 
     double last_frame_clock_;
 
-    std::vector<double> frame_times;
-    double total_frame_time = 0;
-    double frame_per_sec = 0, frame_time_avg = 0, frame_time_var = 0;
+    InputFrame input_;
+    InputLog input_log_;
+    std::string record_path_, replay_path_;
+
+    bool count_gl_calls_ = false;
+
+    ShaderProgram *depth_shader_ = nullptr;
+
+    FrameHistogram frame_stats_{FRAME_STATS_MAX_SAMPLES, FRAME_STATS_WINDOW};
 
     void DestroyEnvMap() {
         if (env_map_depth_rbo_) {
@@ -261,10 +620,25 @@ private:
 
     void DestroyWindow() {
         DestroyEnvMap();
+        camera_uniforms_.Destroy();
+        lights_uniforms_.Destroy();
+        light_grid_.Destroy();
+        delete depth_shader_;
+        depth_shader_ = nullptr;
+        DrawDataRing::GetInstance().Destroy();
+        MaterialLibrary::GetInstance().Destroy();
         if (window_ != nullptr) {
             glfwDestroyWindow(window_);
             window_ = nullptr;
         }
+
+        if (default_framebuffer_ != 0) {
+            glDeleteFramebuffers(1, &default_framebuffer_);
+            glDeleteRenderbuffers(1, &headless_color_rbo_);
+            glDeleteRenderbuffers(1, &headless_depth_rbo_);
+            default_framebuffer_ = headless_color_rbo_ = headless_depth_rbo_ = 0;
+        }
+        headless_context_.Destroy();
     }
 
     static void HandleFramebufferSizeChangeEvent(GLFWwindow *window, int width, int height) {
@@ -272,61 +646,66 @@ private:
         that->HandleFramebufferSizeChange(width, height);
     }
 
-    void HandleKeyboardInput(double delta_frame) {
-        // escape to exit
-        if (glfwGetKey(window_, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            glfwSetWindowShouldClose(window_, true);
-        }
+    /**
+     * Sample the input of this frame from the window.
+     *
+     * @param frame_time seconds since the previous frame
+     */
+    void PollInput(double frame_time) {
+        input_ = InputFrame{.frame_time = frame_time};
 
-        double forward = 0, right = 0, up = 0;
+        double cursor_x, cursor_y;
+        glfwGetCursorPos(window_, &cursor_x, &cursor_y);
+        input_.cursor = glm::vec2(cursor_x, cursor_y);
 
-        // w s to translate forward and backward
-        if (glfwGetKey(window_, GLFW_KEY_W) == GLFW_PRESS) {
-            forward += delta_frame;
+        if (glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+            input_.mouse_buttons |= INPUT_BUTTON_LEFT;
         }
-        if (glfwGetKey(window_, GLFW_KEY_S) == GLFW_PRESS) {
-            forward -= delta_frame;
+        if (glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+            input_.mouse_buttons |= INPUT_BUTTON_RIGHT;
         }
 
-        // a d to translate left and right_
-        if (glfwGetKey(window_, GLFW_KEY_A) == GLFW_PRESS) {
-            right -= delta_frame;
-        }
-        if (glfwGetKey(window_, GLFW_KEY_D) == GLFW_PRESS) {
-            right += delta_frame;
+        if (!io_->WantCaptureMouse) { // otherwise ImGui owns the input, don't move the camera
+            PollCameraInput(cursor_x, cursor_y);
         }
 
-        // r f to translate up_ and down
-        if (glfwGetKey(window_, GLFW_KEY_R) == GLFW_PRESS) {
-            up += delta_frame;
-        }
-        if (glfwGetKey(window_, GLFW_KEY_F) == GLFW_PRESS) {
-            up -= delta_frame;
+        if (mouse_hold_) {
+            input_.mouse_buttons |= INPUT_BUTTON_DRAG;
         }
+    }
 
-        if (abs(forward) > 0.01f || abs(right) > 0.01f || abs(up) > 0.01f) {
-            camera_->Translate((float)forward, (float)right, (float)up);
+    void PollCameraInput(double cursor_x, double cursor_y) {
+        // w s to translate forward and backward, a d to translate left and right, r f to translate up and down
+
+        const std::pair<int, uint16_t> keys[] = {
+            {GLFW_KEY_W, INPUT_KEY_FORWARD},
+            {GLFW_KEY_S, INPUT_KEY_BACKWARD},
+            {GLFW_KEY_A, INPUT_KEY_LEFT},
+            {GLFW_KEY_D, INPUT_KEY_RIGHT},
+            {GLFW_KEY_R, INPUT_KEY_UP},
+            {GLFW_KEY_F, INPUT_KEY_DOWN},
+        };
+        for (auto [key, bit] : keys) {
+            if (glfwGetKey(window_, key) == GLFW_PRESS) {
+                input_.keys |= bit;
+            }
         }
 
-        // TODO: reset camera to initial position_
-    }
+        // drag with left button to rotate
 
-    void HandleMouseInput() {
-        double mouse_x, mouse_y;
         double center_x = double(window_width_) / 2, center_y = double(window_height_) / 2;
-        if (glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+        if (input_.mouse_buttons & INPUT_BUTTON_LEFT) {
             if (!mouse_hold_) {
                 glfwSetCursorPos(window_, center_x, center_y);
                 glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
                 mouse_hold_ = true;
             } else {
-                glfwGetCursorPos(window_, &mouse_x, &mouse_y);
                 glfwSetCursorPos(window_, center_x, center_y);
 
-                mouse_x = (mouse_x - center_x) / window_width_;
-                mouse_y = (mouse_y - center_y) / window_height_;
-                camera_->Rotate(float(-mouse_y), float(mouse_x));
+                auto mouse_x = (cursor_x - center_x) / window_width_;
+                auto mouse_y = (cursor_y - center_y) / window_height_;
+                input_.camera_rotation = glm::vec2(-mouse_y, mouse_x);
             }
         } else {
             glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -335,6 +714,64 @@ private:
         }
     }
 
+    /**
+     * Move the camera by the input of this frame, polled or replayed.
+     */
+    void HandleInput() {
+        mouse_hold_ = input_.mouse_buttons & INPUT_BUTTON_DRAG;
+
+        auto delta_frame = input_.frame_time;
+        double forward = 0, right = 0, up = 0;
+
+        if (input_.keys & INPUT_KEY_FORWARD) {
+            forward += delta_frame;
+        }
+        if (input_.keys & INPUT_KEY_BACKWARD) {
+            forward -= delta_frame;
+        }
+        if (input_.keys & INPUT_KEY_LEFT) {
+            right -= delta_frame;
+        }
+        if (input_.keys & INPUT_KEY_RIGHT) {
+            right += delta_frame;
+        }
+        if (input_.keys & INPUT_KEY_UP) {
+            up += delta_frame;
+        }
+        if (input_.keys & INPUT_KEY_DOWN) {
+            up -= delta_frame;
+        }
+
+        if (abs(forward) > 0.01f || abs(right) > 0.01f || abs(up) > 0.01f) {
+            camera_->Translate((float)forward, (float)right, (float)up);
+        }
+
+        if (input_.camera_rotation != glm::vec2(0.0f)) {
+            camera_->Rotate(input_.camera_rotation.x, input_.camera_rotation.y);
+        }
+
+        // TODO: reset camera to initial position_
+    }
+
+    bool StartInputLog() {
+        if (!record_path_.empty()) {
+            return input_log_.StartRecording(record_path_);
+        }
+
+        if (!replay_path_.empty()) {
+            return input_log_.StartReplay(replay_path_);
+        }
+
+        return true;
+    }
+
+    void DrawEnvMapFaceTo(GLenum face, glm::vec3 position, glm::vec3 direction, glm::vec3 up) {
+        GpuTimerScope scope(gpu_timer_, "env_map_face");
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, face, env_map_.name, 0);
+        DrawEnvMapFace(position, direction, up);
+    }
+
     bool InitializeEnvMap() {
         glGenFramebuffers(1, &env_map_fbo_);
         glBindFramebuffer(GL_FRAMEBUFFER, env_map_fbo_);
@@ -409,15 +846,56 @@ private:
         glfwSetWindowUserPointer(window_, this);
         glfwSetFramebufferSizeCallback(window_, &HandleFramebufferSizeChangeEvent);
 
+        return InitializeContext((GLADloadproc)glfwGetProcAddress);
+    }
+
+    bool InitializeHeadless() {
+        if (!headless_context_.Initialize(4, 1)) {
+            return false;
+        }
+
+        if (!InitializeContext(HeadlessContext::GetProcAddressLoader())) {
+            return false;
+        }
+
+        // surfaceless contexts have no default framebuffer, render into an off-screen one instead
+
+        glGenRenderbuffers(1, &headless_color_rbo_);
+        glBindRenderbuffer(GL_RENDERBUFFER, headless_color_rbo_);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_width_, window_height_);
+
+        glGenRenderbuffers(1, &headless_depth_rbo_);
+        glBindRenderbuffer(GL_RENDERBUFFER, headless_depth_rbo_);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, window_width_, window_height_);
+
+        glGenFramebuffers(1, &default_framebuffer_);
+        glBindFramebuffer(GL_FRAMEBUFFER, default_framebuffer_);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless_color_rbo_);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headless_depth_rbo_);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "FATAL: Headless framebuffer is not complete" << std::endl;
+            return false;
+        }
+
+        return glCheckError() == GL_NO_ERROR;
+    }
+
+    bool InitializeContext(GLADloadproc loader) {
+
         // load extensions
 
-        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        if (!gladLoadGLLoader(loader)) {
             std::cerr << "FATAL: Failed to initialize GLAD" << std::endl;
             return false;
         }
 
         std::cout << "INFO: OpenGL session created, version " << glGetString(GL_VERSION) << std::endl;
 
+        if (count_gl_calls_) {
+            GlCallCounters::GetInstance().Install();
+        }
+
         // enable debug output
 
 #ifdef NDEBUG
@@ -441,9 +919,228 @@ private:
 
         glEnable(GL_MULTISAMPLE);
 
+        // uniform blocks shared by all shaders
+
+        if (!camera_uniforms_.Initialize(CAMERA_UNIFORM_BINDING) ||
+            !lights_uniforms_.Initialize(LIGHTS_UNIFORM_BINDING) || !light_grid_.Initialize()) {
+            std::cerr << "FATAL: Failed to initialize uniform buffers" << std::endl;
+            return false;
+        }
+
+        if (!DrawDataRing::GetInstance().Initialize(loader)) {
+            std::cerr << "FATAL: Failed to initialize draw data buffer" << std::endl;
+            return false;
+        }
+
+        if (!MaterialLibrary::GetInstance().Initialize()) {
+            std::cerr << "FATAL: Failed to initialize material buffer" << std::endl;
+            return false;
+        }
+
+        GlStateCache::GetInstance().Initialize(loader);
+        ShaderCompiler::GetInstance().Initialize(loader);
+
+        depth_shader_ = new ShaderProgram("shaders/depth.vert", "shaders/depth.frag");
+
         return glCheckError() == GL_NO_ERROR;
     }
 
+    void RunBenchmark() {
+        BenchCameraPath camera_path(bench_.frames);
+
+        FrameHistogram frame_times(bench_.frames);
+
+        std::cout << "INFO: Benchmarking " << bench_.frames << " frames at " << window_width_ << "x"
+                  << window_height_ << std::endl;
+
+        current_frame_clock_ = 0;
+        for (size_t frame = 0; frame < bench_.warmup_frames + bench_.frames; ++frame) {
+            auto recording = frame >= bench_.warmup_frames;
+
+            // fixed simulation step, animations advance identically regardless of the frame rate;
+            // a replayed input log replaces the scripted camera path and steps by its recorded frame times
+
+            if (input_log_.IsReplaying()) {
+                if (!input_log_.ReplayFrame(input_)) {
+                    break;
+                }
+                HandleInput();
+            } else {
+                input_ = InputFrame{.frame_time = BENCH_FRAME_TIME};
+                input_.cursor = glm::vec2(window_width_, window_height_) / 2.0f;
+                if (recording) {
+                    camera_path.Apply(camera_, frame - bench_.warmup_frames);
+                }
+            }
+
+            last_frame_time_ = input_.frame_time;
+            current_frame_clock_ += last_frame_time_;
+
+            GlStateCache::GetInstance().BeginFrame();
+            GlCallCounters::GetInstance().BeginFrame();
+            RenderQueue::GetInstance().BeginFrame();
+
+            if (frame == bench_.warmup_frames) {
+                gpu_timer_.ResetTotals();
+                overdraw_counter_.ResetTotals();
+                GlStateCache::GetInstance().ResetTotals();
+                GlCallCounters::GetInstance().ResetTotals();
+                RenderQueue::GetInstance().ResetTotals();
+            }
+
+            auto begin = std::chrono::steady_clock::now();
+
+            DrawDataRing::GetInstance().BeginFrame();
+            gpu_timer_.BeginFrame();
+            overdraw_counter_.BeginFrame();
+            {
+                TRACE_SCOPE("Program::Draw");
+                GpuTimerScope scope(gpu_timer_, "frame");
+                Draw();
+            }
+            overdraw_counter_.EndFrame();
+            gpu_timer_.EndFrame();
+            DrawDataRing::GetInstance().EndFrame();
+
+            glFinish(); // there is no swap to throttle on, wait for the GPU so each frame is fully accounted
+
+            auto end = std::chrono::steady_clock::now();
+
+            input_log_.ApplyChanges();
+
+            if (recording) {
+                frame_times.Add(std::chrono::duration<double>(end - begin).count());
+            }
+        }
+
+        // resolve the frames still in flight
+
+        for (size_t i = 0; i < GPU_TIMER_FRAMES; ++i) {
+            gpu_timer_.BeginFrame();
+            gpu_timer_.EndFrame();
+        }
+
+        for (size_t i = 0; i < OVERDRAW_COUNTER_FRAMES; ++i) {
+            overdraw_counter_.BeginFrame();
+            overdraw_counter_.EndFrame();
+        }
+
+        GlStateCache::GetInstance().BeginFrame(); // count the last frame
+        GlCallCounters::GetInstance().BeginFrame();
+        RenderQueue::GetInstance().BeginFrame();
+
+        glCheckError();
+
+        WriteBenchReport(frame_times);
+    }
+
+    static void PrintProgramCacheSummary() {
+        const auto &stats = ProgramBinaryCache::GetInstance().GetStats();
+        if (stats.hits + stats.misses == 0) {
+            return;
+        }
+
+        std::cout << "INFO: Program cache: " << stats.hits << " programs loaded, " << stats.misses << " compiled";
+        if (stats.rejected > 0) {
+            std::cout << " (" << stats.rejected << " entries rejected)";
+        }
+        std::cout << ", saved " << stats.saved_seconds * 1000 << " ms of startup" << std::endl;
+    }
+
+    void WriteBenchReport(const FrameHistogram &frame_times) const {
+        std::ofstream file(bench_.output_path);
+        if (!file) {
+            std::cerr << "ERROR: Failed to open benchmark report " << bench_.output_path << std::endl;
+            return;
+        }
+
+        JsonWriter json(file);
+        json.BeginObject();
+        json.String("program", window_title_);
+        json.String("renderer", (const char *)glGetString(GL_RENDERER));
+        json.String("version", (const char *)glGetString(GL_VERSION));
+        json.String("vertex_format", Mesh::GetDefaultLayout()->name);
+        json.Number("lod", RenderQueue::GetInstance().IsLodEnabled() ? 1 : 0);
+        json.Number("width", window_width_);
+        json.Number("height", window_height_);
+        json.Number("frames", double(frame_times.GetCount()));
+
+        json.BeginObject("frame_time_ms");
+        json.Number("mean", frame_times.GetMean() * 1000);
+        json.Number("stddev", std::sqrt(frame_times.GetVariance()) * 1000);
+        json.Number("p50", frame_times.GetPercentile(50) * 1000);
+        json.Number("p95", frame_times.GetPercentile(95) * 1000);
+        json.Number("p99", frame_times.GetPercentile(99) * 1000);
+        json.Number("max", frame_times.GetMax() * 1000);
+        json.EndObject();
+
+        json.BeginObject("gpu_time_ms");
+        for (const auto &[name, milliseconds] : gpu_timer_.GetAverages()) {
+            json.Number(name, milliseconds);
+        }
+        json.EndObject();
+
+        auto n_frames = double(std::max(frame_times.GetCount(), size_t(1)));
+        const auto &gl_state = GlStateCache::GetInstance().GetTotals();
+        json.BeginObject("gl_state_per_frame");
+        json.Number("program_binds", double(gl_state.program_binds) / n_frames);
+        json.Number("program_skips", double(gl_state.program_skips) / n_frames);
+        json.Number("vertex_array_binds", double(gl_state.vertex_array_binds) / n_frames);
+        json.Number("vertex_array_skips", double(gl_state.vertex_array_skips) / n_frames);
+        json.Number("texture_binds", double(gl_state.texture_binds) / n_frames);
+        json.Number("texture_skips", double(gl_state.texture_skips) / n_frames);
+        json.Number("active_texture_changes", double(gl_state.active_texture_changes) / n_frames);
+        json.Number("active_texture_skips", double(gl_state.active_texture_skips) / n_frames);
+        json.EndObject();
+
+        if (GlCallCounters::GetInstance().IsInstalled()) {
+            const auto &gl_calls = GlCallCounters::GetInstance().GetTotals();
+            json.BeginObject("gl_calls_per_frame");
+            json.Number("draw_calls", double(gl_calls.draw_calls) / n_frames);
+            json.Number("triangles", double(gl_calls.triangles) / n_frames);
+            json.Number("state_changes", double(gl_calls.state_changes) / n_frames);
+            json.Number("uniform_updates", double(gl_calls.uniform_updates) / n_frames);
+            json.Number("buffer_uploads", double(gl_calls.buffer_uploads) / n_frames);
+            json.Number("buffer_bytes_uploaded", double(gl_calls.buffer_bytes_uploaded) / n_frames);
+            json.Number("texture_uploads", double(gl_calls.texture_uploads) / n_frames);
+            json.Number("texture_bytes_uploaded", double(gl_calls.texture_bytes_uploaded) / n_frames);
+            json.Number("buffer_bytes_read", double(gl_calls.buffer_bytes_read) / n_frames);
+            json.EndObject();
+        }
+
+        const auto &culling = RenderQueue::GetInstance().GetTotals();
+        json.BeginObject("culling_per_frame");
+        json.Number("enabled", RenderQueue::GetInstance().IsCullingEnabled() ? 1 : 0);
+        json.Number("visible_meshes", double(culling.visible_meshes) / n_frames);
+        json.Number("culled_meshes", double(culling.culled_meshes) / n_frames);
+        json.Number("culled_subtrees", double(culling.culled_subtrees) / n_frames);
+        json.Number("frustum_tests", double(culling.frustum_tests) / n_frames);
+        json.EndObject();
+
+        const auto &overdraw = overdraw_counter_.GetTotals();
+        auto n_overdraw_frames = double(std::max(overdraw_counter_.GetTotalFrames(), size_t(1)));
+        json.BeginObject("overdraw_per_frame");
+        json.Number("depth_prepass", depth_prepass_ ? 1 : 0);
+        json.Number("prepass_samples", double(overdraw.prepass_samples) / n_overdraw_frames);
+        json.Number("shaded_samples", double(overdraw.shaded_samples) / n_overdraw_frames);
+        json.Number("removed_samples", double(overdraw.GetRemoved()) / n_overdraw_frames);
+        json.EndObject();
+
+        const auto &program_cache = ProgramBinaryCache::GetInstance().GetStats();
+        json.BeginObject("program_cache");
+        json.Number("hits", double(program_cache.hits));
+        json.Number("misses", double(program_cache.misses));
+        json.Number("rejected", double(program_cache.rejected));
+        json.Number("load_ms", program_cache.load_seconds * 1000);
+        json.Number("compile_ms", program_cache.compile_seconds * 1000);
+        json.Number("saved_ms", program_cache.saved_seconds * 1000);
+        json.EndObject();
+
+        json.EndObject();
+
+        std::cout << "INFO: Benchmark report written to " << bench_.output_path << std::endl;
+    }
+
     static void HandleDebugOutput(GLenum source,
                                   GLenum type,
                                   unsigned int id,
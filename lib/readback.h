@@ -0,0 +1,117 @@
+#ifndef LIB_READBACK_H_
+#define LIB_READBACK_H_
+
+#include <glad/glad.h>
+
+#include "utils.h"
+
+#define READBACK_FRAMES 3 // buffers in flight, results are consumed READBACK_FRAMES - 1 frames after they are captured
+
+/**
+ * Ring of GPU buffers for reading results back to the CPU without stalling.
+ *
+ * Every frame captures into the current slot and fences it with EndWrite(). Read() copies the oldest slot, captured
+ * READBACK_FRAMES - 1 frames earlier, and only if its fence has already signalled; otherwise the result is skipped
+ * and the consumer keeps its previous value. Each slot also carries a query object for checking how much was captured.
+ */
+class ReadbackRing {
+public:
+    bool Initialize(GLsizeiptr size) {
+        size_ = size;
+
+        for (auto &slot : slots_) {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, slot.buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, size_, nullptr, GL_DYNAMIC_READ);
+
+            glGenQueries(1, &slot.query);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        return glCheckError() == GL_NO_ERROR;
+    }
+
+    void Destroy() {
+        for (auto &slot : slots_) {
+            if (slot.fence != nullptr) {
+                glDeleteSync(slot.fence);
+                slot.fence = nullptr;
+            }
+            glDeleteQueries(1, &slot.query);
+            glDeleteBuffers(1, &slot.buffer);
+            slot.query = slot.buffer = 0;
+        }
+    }
+
+    /**
+     * @return buffer to capture into this frame
+     */
+    [[nodiscard]] GLuint GetWriteBuffer() const { return slots_[write_index_].buffer; }
+
+    /**
+     * @return query object of this frame, e.g. for GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN
+     */
+    [[nodiscard]] GLuint GetWriteQuery() const { return slots_[write_index_].query; }
+
+    /**
+     * Fence the commands capturing into the current slot and move on to the next one.
+     */
+    void EndWrite() {
+        auto &slot = slots_[write_index_];
+        if (slot.fence != nullptr) {
+            glDeleteSync(slot.fence);
+        }
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        write_index_ = (write_index_ + 1) % READBACK_FRAMES;
+    }
+
+    /**
+     * Copy the oldest captured slot, must be called before capturing into the next one.
+     *
+     * @param data destination of at least the size passed to Initialize()
+     * @param query_result if not null, receives the result of the slot's query
+     * @return whether a result was ready
+     */
+    bool Read(void *data, GLint *query_result = nullptr) {
+        auto &slot = slots_[write_index_];
+        if (slot.fence == nullptr) {
+            return false; // nothing captured yet
+        }
+
+        auto status = glClientWaitSync(slot.fence, 0, 0);
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            ++n_missed_reads_; // the GPU is more than READBACK_FRAMES - 1 frames behind, don't wait for it
+            return false;
+        }
+
+        if (query_result != nullptr) {
+            glGetQueryObjectiv(slot.query, GL_QUERY_RESULT, query_result);
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, slot.buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size_, data);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        return glCheckError() == GL_NO_ERROR;
+    }
+
+    [[nodiscard]] size_t GetMissedReads() const { return n_missed_reads_; }
+
+private:
+    struct Slot {
+        GLuint buffer = 0, query = 0;
+        GLsync fence = nullptr;
+    };
+
+    Slot slots_[READBACK_FRAMES];
+    size_t write_index_ = 0;
+
+    GLsizeiptr size_ = 0;
+    size_t n_missed_reads_ = 0;
+};
+
+#endif // LIB_READBACK_H_
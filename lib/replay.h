@@ -0,0 +1,242 @@
+#ifndef LIB_REPLAY_H_
+#define LIB_REPLAY_H_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#define INPUT_LOG_MAGIC 0x4C494743 // "CGIL"
+#define INPUT_LOG_VERSION 1
+
+const uint16_t INPUT_KEY_FORWARD = 1 << 0;
+const uint16_t INPUT_KEY_BACKWARD = 1 << 1;
+const uint16_t INPUT_KEY_LEFT = 1 << 2;
+const uint16_t INPUT_KEY_RIGHT = 1 << 3;
+const uint16_t INPUT_KEY_UP = 1 << 4;
+const uint16_t INPUT_KEY_DOWN = 1 << 5;
+
+const uint8_t INPUT_BUTTON_LEFT = 1 << 0;
+const uint8_t INPUT_BUTTON_RIGHT = 1 << 1;
+const uint8_t INPUT_BUTTON_DRAG = 1 << 2; // left button held over the scene, rotating the camera
+
+/**
+ * Everything a frame reads from the user, except values edited through ImGui, see InputLog::Track().
+ */
+struct InputFrame {
+    double frame_time = 0;           // simulation step of the frame, in seconds
+    uint16_t keys = 0;               // INPUT_KEY_* held down
+    uint8_t mouse_buttons = 0;       // INPUT_BUTTON_* held down
+    glm::vec2 cursor{0.0f};          // cursor position in window coordinates
+    glm::vec2 camera_rotation{0.0f}; // pitch and yaw from dragging, as passed to BaseCamera::Rotate
+};
+
+/**
+ * Compact binary log of per-frame input, for recording a session and replaying it deterministically.
+ *
+ * Values edited through ImGui are registered with Track(); the log stores only the values that changed in a frame.
+ * The header lists the tracked names, so a log only replays on a program that tracks the same values.
+ *
+ * Layout (native endianness):
+ *   header:  u32 magic, u32 version, u16 n_tracked, n_tracked * (u16 name length, name, u16 value size)
+ *   frame:   f64 frame_time, u16 keys, u8 mouse_buttons, 4 * f32 cursor and camera rotation,
+ *            u16 n_changes, n_changes * (u16 tracked index, value)
+ */
+class InputLog {
+public:
+    /**
+     * @param value must outlive the log, trivially copyable
+     */
+    template <typename T> void Track(const std::string &name, T *value) {
+        static_assert(std::is_trivially_copyable_v<T>, "tracked values are logged by their bytes");
+
+        tracked_.push_back(TrackedValue{
+            .name = name,
+            .value = reinterpret_cast<uint8_t *>(value),
+            .last = std::vector<uint8_t>(sizeof(T)),
+        });
+    }
+
+    bool StartRecording(const std::string &path) {
+        file_.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!file_) {
+            std::cerr << "ERROR: Failed to open input log for writing: " << path << std::endl;
+            return false;
+        }
+
+        SnapshotTracked();
+
+        Write(uint32_t(INPUT_LOG_MAGIC));
+        Write(uint32_t(INPUT_LOG_VERSION));
+        Write(uint16_t(tracked_.size()));
+        for (const auto &tracked : tracked_) {
+            Write(uint16_t(tracked.name.size()));
+            file_.write(tracked.name.data(), std::streamsize(tracked.name.size()));
+            Write(uint16_t(tracked.last.size()));
+        }
+
+        recording_ = true;
+        return bool(file_);
+    }
+
+    bool StartReplay(const std::string &path) {
+        file_.open(path, std::ios::binary | std::ios::in);
+        if (!file_) {
+            std::cerr << "ERROR: Failed to open input log for reading: " << path << std::endl;
+            return false;
+        }
+
+        uint32_t magic = 0, version = 0;
+        if (!Read(magic) || !Read(version) || magic != INPUT_LOG_MAGIC || version != INPUT_LOG_VERSION) {
+            std::cerr << "ERROR: Not an input log of version " << INPUT_LOG_VERSION << ": " << path << std::endl;
+            return false;
+        }
+
+        uint16_t n_tracked = 0;
+        Read(n_tracked);
+        if (n_tracked != tracked_.size()) {
+            std::cerr << "ERROR: Input log tracks " << n_tracked << " values, program tracks " << tracked_.size()
+                      << std::endl;
+            return false;
+        }
+
+        for (const auto &tracked : tracked_) {
+            uint16_t name_length = 0, size = 0;
+            Read(name_length);
+            std::string name(name_length, '\0');
+            file_.read(name.data(), name_length);
+            Read(size);
+
+            if (!file_ || name != tracked.name || size != tracked.last.size()) {
+                std::cerr << "ERROR: Input log value " << name << " does not match program value " << tracked.name
+                          << std::endl;
+                return false;
+            }
+        }
+
+        SnapshotTracked();
+
+        replaying_ = true;
+        return true;
+    }
+
+    [[nodiscard]] bool IsRecording() const { return recording_; }
+
+    [[nodiscard]] bool IsReplaying() const { return replaying_; }
+
+    /**
+     * Append a frame, with the tracked values that changed since the previous one.
+     */
+    void RecordFrame(const InputFrame &frame) {
+        WriteFrame(frame);
+
+        changes_.clear();
+        for (size_t i = 0; i < tracked_.size(); ++i) {
+            auto &tracked = tracked_[i];
+            if (std::memcmp(tracked.value, tracked.last.data(), tracked.last.size()) != 0) {
+                std::memcpy(tracked.last.data(), tracked.value, tracked.last.size());
+                changes_.push_back(uint16_t(i));
+            }
+        }
+
+        Write(uint16_t(changes_.size()));
+        for (auto i : changes_) {
+            Write(i);
+            file_.write(reinterpret_cast<const char *>(tracked_[i].last.data()),
+                        std::streamsize(tracked_[i].last.size()));
+        }
+    }
+
+    /**
+     * Read the input of the next frame, its value changes are held back until ApplyChanges().
+     *
+     * @return false at the end of the log
+     */
+    bool ReplayFrame(InputFrame &frame) {
+        changes_.clear();
+
+        if (!ReadFrame(frame)) {
+            return false;
+        }
+
+        uint16_t n_changes = 0;
+        Read(n_changes);
+        for (uint16_t i = 0; i < n_changes; ++i) {
+            uint16_t index = 0;
+            Read(index);
+            if (index >= tracked_.size()) {
+                std::cerr << "ERROR: Input log is corrupted" << std::endl;
+                return false;
+            }
+
+            auto &tracked = tracked_[index];
+            file_.read(reinterpret_cast<char *>(tracked.last.data()), std::streamsize(tracked.last.size()));
+            changes_.push_back(index);
+        }
+
+        return bool(file_);
+    }
+
+    /**
+     * Apply the value changes of the replayed frame, at the point of the frame where they were recorded.
+     */
+    void ApplyChanges() {
+        for (auto i : changes_) {
+            std::memcpy(tracked_[i].value, tracked_[i].last.data(), tracked_[i].last.size());
+        }
+        changes_.clear();
+    }
+
+    void Close() {
+        file_.close();
+        recording_ = replaying_ = false;
+    }
+
+private:
+    struct TrackedValue {
+        std::string name;
+        uint8_t *value;
+        std::vector<uint8_t> last; // value as of the last recorded or replayed frame
+    };
+
+    std::fstream file_;
+    bool recording_ = false, replaying_ = false;
+
+    std::vector<TrackedValue> tracked_;
+    std::vector<uint16_t> changes_; // indices of tracked values changed in the current frame
+
+    void SnapshotTracked() {
+        for (auto &tracked : tracked_) {
+            std::memcpy(tracked.last.data(), tracked.value, tracked.last.size());
+        }
+    }
+
+    template <typename T> void Write(T value) { file_.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+    template <typename T> bool Read(T &value) {
+        file_.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return bool(file_);
+    }
+
+    void WriteFrame(const InputFrame &frame) {
+        Write(frame.frame_time);
+        Write(frame.keys);
+        Write(frame.mouse_buttons);
+        Write(frame.cursor.x);
+        Write(frame.cursor.y);
+        Write(frame.camera_rotation.x);
+        Write(frame.camera_rotation.y);
+    }
+
+    bool ReadFrame(InputFrame &frame) {
+        return Read(frame.frame_time) && Read(frame.keys) && Read(frame.mouse_buttons) && Read(frame.cursor.x) &&
+               Read(frame.cursor.y) && Read(frame.camera_rotation.x) && Read(frame.camera_rotation.y);
+    }
+};
+
+#endif // LIB_REPLAY_H_
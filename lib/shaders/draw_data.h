@@ -0,0 +1,207 @@
+#ifndef LIB_SHADERS_DRAW_DATA_H_
+#define LIB_SHADERS_DRAW_DATA_H_
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../utils.h"
+
+#define DRAW_DATA_FRAMES 3            // frames in flight, a frame's slots are reused DRAW_DATA_FRAMES frames later
+#define DRAW_DATA_FRAME_CAPACITY 4096 // draws per frame before the ring has to wait for the GPU
+#define DRAW_DATA_WINDOW 128          // draws visible to a shader at once, 128 * 128 bytes is the minimum UBO size
+#define DRAW_DATA_UNIFORM_BINDING 2   // binding point of the Draws uniform block
+
+// ARB_buffer_storage, core since 4.4 and not part of the 4.3 glad loader
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void(APIENTRYP PFNGLBUFFERSTORAGEPROC_)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+/**
+ * std140 layout of one element of the Draws uniform block:
+ *
+ *   struct DrawData {
+ *       mat4 modelMatrix;
+ *       mat4 modelNormalMatrix;
+ *   };
+ *
+ *   layout(std140) uniform Draws {
+ *       DrawData draws[128];
+ *   };
+ *
+ *   uniform int drawIndex;
+ */
+struct DrawData {
+    glm::mat4 model_matrix;
+    glm::mat4 model_normal_matrix;
+};
+
+static_assert(sizeof(DrawData) == 128);
+
+/**
+ * Ring buffer of per-draw data, written once per draw and read by shaders as draws[drawIndex].
+ *
+ * With buffer storage the ring is mapped persistently and coherently, so writing a draw is a memcpy; otherwise each
+ * draw is uploaded with glBufferSubData. Shaders see a window of DRAW_DATA_WINDOW draws, the window is moved along
+ * the ring when it fills. Every frame writes its own segment, fenced at EndFrame() and waited for DRAW_DATA_FRAMES
+ * frames later.
+ */
+class DrawDataRing {
+public:
+    static DrawDataRing &GetInstance() {
+        static DrawDataRing instance;
+        return instance;
+    }
+
+    /**
+     * @param loader for glBufferStorage, which glad does not load
+     */
+    bool Initialize(GLADloadproc loader) {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        window_alignment_ = std::max(size_t(alignment) / sizeof(DrawData), size_t(1));
+
+        auto size = GLsizeiptr(kCapacity * sizeof(DrawData));
+
+        glGenBuffers(1, &buffer_);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+
+        auto buffer_storage = HasBufferStorage() ? (PFNGLBUFFERSTORAGEPROC_)loader("glBufferStorage") : nullptr;
+        if (buffer_storage != nullptr) {
+            auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            buffer_storage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+            mapped_ = (DrawData *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+        }
+
+        if (mapped_ == nullptr) {
+            std::cout << "INFO: Persistent buffer mapping is not available, uploading draw data per draw" << std::endl;
+            glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+
+        return glCheckError() == GL_NO_ERROR;
+    }
+
+    void Destroy() {
+        for (auto &fence : fences_) {
+            if (fence != nullptr) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        if (buffer_ != 0) {
+            if (mapped_ != nullptr) {
+                glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+                mapped_ = nullptr;
+            }
+            glDeleteBuffers(1, &buffer_);
+            buffer_ = 0;
+        }
+    }
+
+    /**
+     * Move on to the next frame's segment, waiting if the GPU still reads it.
+     */
+    void BeginFrame() {
+        frame_index_ = (frame_index_ + 1) % DRAW_DATA_FRAMES;
+        WaitForFence(fences_[frame_index_]);
+
+        next_ = frame_index_ * DRAW_DATA_FRAME_CAPACITY;
+        window_begin_ = kNoWindow;
+    }
+
+    void EndFrame() {
+        if (fences_[frame_index_] != nullptr) {
+            glDeleteSync(fences_[frame_index_]);
+        }
+        fences_[frame_index_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    /**
+     * Store the data of the next draw, moving the shader window if needed.
+     *
+     * @return value of the drawIndex uniform for the draw
+     */
+    GLint Write(const DrawData &data) {
+        auto segment_begin = frame_index_ * DRAW_DATA_FRAME_CAPACITY;
+        auto segment_end = segment_begin + DRAW_DATA_FRAME_CAPACITY;
+
+        if (window_begin_ == kNoWindow || next_ >= window_begin_ + DRAW_DATA_WINDOW || next_ >= segment_end) {
+            auto window_begin = (next_ + window_alignment_ - 1) / window_alignment_ * window_alignment_;
+            if (window_begin >= segment_end) {
+                std::cerr << "WARNING: More than " << DRAW_DATA_FRAME_CAPACITY << " draws in a frame" << std::endl;
+
+                // the segment is still read by this frame's draws, start over once they are done
+
+                GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                WaitForFence(fence);
+
+                window_begin = segment_begin;
+            }
+
+            window_begin_ = next_ = window_begin;
+
+            glBindBufferRange(GL_UNIFORM_BUFFER,
+                              DRAW_DATA_UNIFORM_BINDING,
+                              buffer_,
+                              GLintptr(window_begin_ * sizeof(DrawData)),
+                              GLsizeiptr(DRAW_DATA_WINDOW * sizeof(DrawData)));
+        }
+
+        if (mapped_ != nullptr) {
+            std::memcpy(mapped_ + next_, &data, sizeof(DrawData));
+        } else {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+            glBufferSubData(GL_UNIFORM_BUFFER, GLintptr(next_ * sizeof(DrawData)), sizeof(DrawData), &data);
+        }
+
+        return GLint(next_++ - window_begin_);
+    }
+
+private:
+    // a window starting near the end of the last segment reaches past it, padding keeps the bound range in the buffer
+    static constexpr size_t kCapacity = DRAW_DATA_FRAMES * DRAW_DATA_FRAME_CAPACITY + DRAW_DATA_WINDOW;
+
+    static constexpr size_t kNoWindow = ~size_t(0);
+
+    GLuint buffer_ = 0;
+    DrawData *mapped_ = nullptr;
+
+    GLsync fences_[DRAW_DATA_FRAMES] = {};
+    size_t frame_index_ = 0;
+
+    size_t next_ = 0, window_begin_ = kNoWindow, window_alignment_ = 1;
+
+    DrawDataRing() = default;
+
+    static bool HasBufferStorage() {
+        if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4)) {
+            return true;
+        }
+
+        return HasOpenGLExtension("GL_ARB_buffer_storage");
+    }
+
+    static void WaitForFence(GLsync &fence) {
+        if (fence == nullptr) {
+            return;
+        }
+
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1e9));
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+};
+
+#endif // LIB_SHADERS_DRAW_DATA_H_
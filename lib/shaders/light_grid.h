@@ -0,0 +1,356 @@
+#ifndef LIB_SHADERS_LIGHT_GRID_H_
+#define LIB_SHADERS_LIGHT_GRID_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../utils.h"
+#include "uniform_buffer.h"
+
+#define LIGHT_GRID_X 16 // clusters across the viewport
+#define LIGHT_GRID_Y 9  // clusters down the viewport
+#define LIGHT_GRID_Z 24 // depth slices, spaced exponentially between the near and far planes
+#define LIGHT_GRID_CLUSTERS (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z)
+
+#define LIGHT_GRID_MAX_LIGHTS 8192   // point lights
+#define LIGHT_GRID_MAX_INDICES 65536 // light references over all clusters, unless the driver allows more
+#define LIGHT_GRID_UNIFORM_BINDING 4 // binding point of the LightGrid uniform block
+#define LIGHT_GRID_TEXTURE_UNIT 20   // first of the three texture units holding the grid, see LightGrid
+
+/**
+ * Sampler uniforms of the grid, bound to LIGHT_GRID_TEXTURE_UNIT onwards in this order.
+ */
+constexpr const char *kLightGridSamplers[] = {"pointLights", "lightClusters", "lightIndices"};
+
+/**
+ * Point light with a finite radius, only shaded by the clusters its sphere overlaps.
+ */
+struct PointLight {
+    glm::vec3 position{0.0f};
+    float radius = 1.0f;
+    glm::vec3 color{1.0f};
+};
+
+/**
+ * std140 layout of the LightGrid uniform block:
+ *
+ *   layout(std140) uniform LightGrid {
+ *       vec2 lightGridTileScale;   // clusters per pixel
+ *       float lightGridDepthScale; // slice = log(depth) * scale + bias
+ *       float lightGridDepthBias;
+ *       ivec3 lightGridSize;
+ *   };
+ */
+struct LightGridUniforms {
+    glm::vec2 tile_scale{0.0f};
+    float depth_scale = 0, depth_bias = 0;
+    glm::ivec4 size{LIGHT_GRID_X, LIGHT_GRID_Y, LIGHT_GRID_Z, 0}; // w is padding
+};
+
+static_assert(offsetof(LightGridUniforms, depth_scale) == 8);
+static_assert(offsetof(LightGridUniforms, size) == 16);
+
+/**
+ * Point lights and the clusters they overlap, from the last Build().
+ */
+struct LightGridStats {
+    size_t lights = 0, visible_lights = 0;
+    size_t references = 0, max_cluster_lights = 0;
+};
+
+/**
+ * Clustered point lights. The view frustum is split into LIGHT_GRID_X * LIGHT_GRID_Y screen tiles by LIGHT_GRID_Z
+ * depth slices, and every cluster lists the lights whose sphere overlaps it, so a fragment only shades the lights of
+ * its own cluster.
+ *
+ * The grid is rebuilt on the CPU for every view and read by shaders from texture buffers on three consecutive units
+ * from LIGHT_GRID_TEXTURE_UNIT:
+ *
+ *   uniform samplerBuffer pointLights;    // position and radius, color; two texels per light
+ *   uniform usamplerBuffer lightClusters; // first index and count of the cluster's lights
+ *   uniform usamplerBuffer lightIndices;  // light indices, grouped by cluster
+ *
+ * Clusters are indexed (z * LIGHT_GRID_Y + y) * LIGHT_GRID_X + x, with y from the bottom of the viewport.
+ */
+class LightGrid {
+public:
+    static constexpr size_t kNoLight = std::numeric_limits<size_t>::max(); // returned once the light limit is reached
+
+    bool Initialize() {
+        if (!uniform_buffer_.Initialize(LIGHT_GRID_UNIFORM_BINDING)) {
+            return false;
+        }
+
+        GLint max_texels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+        max_indices_ = std::clamp(size_t(max_texels), size_t(LIGHT_GRID_MAX_INDICES), kMaxIndicesLimit);
+
+        glGenBuffers(kBuffers, buffers_);
+        glGenTextures(kBuffers, textures_);
+
+        const GLenum formats[kBuffers] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for (GLuint i = 0; i < kBuffers; ++i) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers_[i]);
+            glBufferData(GL_TEXTURE_BUFFER, kMinBufferSize, nullptr, GL_STREAM_DRAW);
+
+            // the units are left to the grid, binding once is enough
+
+            glActiveTexture(GL_TEXTURE0 + LIGHT_GRID_TEXTURE_UNIT + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures_[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers_[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        ranges_.assign(LIGHT_GRID_CLUSTERS, glm::uvec2(0));
+        Upload(true);
+
+        return glCheckError() == GL_NO_ERROR;
+    }
+
+    void Destroy() {
+        if (buffers_[0] != 0) {
+            glDeleteTextures(kBuffers, textures_);
+            glDeleteBuffers(kBuffers, buffers_);
+            std::fill_n(buffers_, kBuffers, 0);
+            std::fill_n(textures_, kBuffers, 0);
+        }
+        uniform_buffer_.Destroy();
+    }
+
+    /**
+     * @return index of the light, for SetLight(), or kNoLight if LIGHT_GRID_MAX_LIGHTS lights were already added
+     */
+    size_t AddLight(const PointLight &light) {
+        if (lights_.size() >= LIGHT_GRID_MAX_LIGHTS) {
+            std::cerr << "WARNING: Point light limit " << LIGHT_GRID_MAX_LIGHTS << " reached" << std::endl;
+            return kNoLight;
+        }
+
+        lights_.push_back(light);
+        return lights_.size() - 1;
+    }
+
+    /**
+     * @param index of a light added before, kNoLight is ignored
+     */
+    void SetLight(size_t index, const PointLight &light) {
+        if (index == kNoLight) {
+            return; // AddLight() already warned
+        }
+        if (index >= lights_.size()) {
+            std::cerr << "WARNING: Point light index " << index << " is out of range" << std::endl;
+            return;
+        }
+
+        lights_[index] = light;
+    }
+
+    void ClearLights() { lights_.clear(); }
+
+    /**
+     * Assign the lights to the clusters of a view, without uploading them.
+     *
+     * @param width viewport width
+     * @param height viewport height
+     */
+    void Build(const glm::mat4 &view_matrix,
+               const glm::mat4 &projection_matrix,
+               float z_near,
+               float z_far,
+               unsigned int width,
+               unsigned int height) {
+        auto log_ratio = std::log(z_far / z_near);
+        uniforms_.tile_scale = glm::vec2(float(LIGHT_GRID_X) / float(width), float(LIGHT_GRID_Y) / float(height));
+        uniforms_.depth_scale = float(LIGHT_GRID_Z) / log_ratio;
+        uniforms_.depth_bias = -float(LIGHT_GRID_Z) * std::log(z_near) / log_ratio;
+
+        // count the lights of every cluster, then lay the clusters out one after another
+
+        ranges_.assign(LIGHT_GRID_CLUSTERS, glm::uvec2(0));
+        bounds_.clear();
+        for (size_t i = 0; i < lights_.size(); ++i) {
+            ClusterBounds bounds{.light = GLuint(i)};
+            if (GetClusterBounds(lights_[i], view_matrix, projection_matrix, z_near, z_far, bounds)) {
+                ForEachCluster(bounds, [this](size_t cluster) { ++ranges_[cluster].y; });
+                bounds_.push_back(bounds);
+            }
+        }
+
+        GLuint first = 0;
+        stats_.max_cluster_lights = 0;
+        for (auto &range : ranges_) {
+            stats_.max_cluster_lights = std::max(stats_.max_cluster_lights, size_t(range.y));
+            range.x = first;
+            first += range.y;
+            range.y = 0; // recounted while filling
+        }
+
+        if (first > max_indices_ && !overflow_warned_) {
+            std::cerr << "WARNING: Point lights overlap clusters " << first << " times, only " << max_indices_
+                      << " are shaded" << std::endl;
+            overflow_warned_ = true;
+        }
+
+        indices_.resize(std::min(size_t(first), max_indices_));
+        for (const auto &bounds : bounds_) {
+            ForEachCluster(bounds, [this, &bounds](size_t cluster) {
+                auto &range = ranges_[cluster];
+                if (range.x + range.y < indices_.size()) {
+                    indices_[range.x + range.y++] = bounds.light;
+                }
+            });
+        }
+
+        stats_.lights = lights_.size();
+        stats_.visible_lights = bounds_.size();
+        stats_.references = indices_.size();
+    }
+
+    /**
+     * Upload the grid of the last Build(), the buffers are only touched while there are lights or were last time.
+     */
+    void Upload(bool force = false) {
+        uniform_buffer_.Upload(uniforms_);
+
+        if (!force && lights_.empty() && uploaded_empty_) {
+            return;
+        }
+
+        std::vector<glm::vec4> texels;
+        texels.reserve(lights_.size() * 2);
+        for (const auto &light : lights_) {
+            texels.emplace_back(light.position, light.radius);
+            texels.emplace_back(light.color, 0.0f);
+        }
+
+        UploadBuffer(buffers_[0], texels.data(), texels.size() * sizeof(glm::vec4));
+        UploadBuffer(buffers_[1], ranges_.data(), ranges_.size() * sizeof(glm::uvec2));
+        UploadBuffer(buffers_[2], indices_.data(), indices_.size() * sizeof(GLuint));
+
+        uploaded_empty_ = lights_.empty();
+    }
+
+    [[nodiscard]] const std::vector<PointLight> &GetLights() const { return lights_; }
+
+    [[nodiscard]] const LightGridStats &GetStats() const { return stats_; }
+
+    /**
+     * @return first index and count of a cluster's lights in GetIndices()
+     */
+    [[nodiscard]] glm::uvec2 GetCluster(size_t x, size_t y, size_t z) const {
+        return ranges_[(z * LIGHT_GRID_Y + y) * LIGHT_GRID_X + x];
+    }
+
+    [[nodiscard]] const std::vector<GLuint> &GetIndices() const { return indices_; }
+
+private:
+    static constexpr GLsizei kBuffers = 3;
+    static constexpr GLsizeiptr kMinBufferSize = 16;     // texture buffers are never left without storage
+    static constexpr size_t kMaxIndicesLimit = 1 << 22; // 16 MiB of indices
+
+    struct ClusterBounds {
+        GLuint light;
+        int x0 = 0, x1 = 0, y0 = 0, y1 = 0, z0 = 0, z1 = 0; // inclusive
+    };
+
+    GLuint buffers_[kBuffers]{}, textures_[kBuffers]{};
+    UniformBuffer<LightGridUniforms> uniform_buffer_;
+    LightGridUniforms uniforms_;
+    bool uploaded_empty_ = false, overflow_warned_ = false;
+    size_t max_indices_ = LIGHT_GRID_MAX_INDICES;
+
+    std::vector<PointLight> lights_;
+    std::vector<ClusterBounds> bounds_;
+    std::vector<glm::uvec2> ranges_; // by cluster
+    std::vector<GLuint> indices_;
+
+    LightGridStats stats_;
+
+    /**
+     * Conservative cluster range of a light, from its view-space bounding box.
+     *
+     * @return false if the light is outside the view
+     */
+    bool GetClusterBounds(const PointLight &light,
+                          const glm::mat4 &view_matrix,
+                          const glm::mat4 &projection_matrix,
+                          float z_near,
+                          float z_far,
+                          ClusterBounds &bounds) const {
+        auto center = glm::vec3(view_matrix * glm::vec4(light.position, 1.0f));
+        auto depth = -center.z, radius = light.radius;
+        if (depth + radius < z_near || depth - radius > z_far) {
+            return false;
+        }
+
+        bounds.z0 = GetSlice(std::max(depth - radius, z_near));
+        bounds.z1 = GetSlice(std::min(depth + radius, z_far));
+
+        if (depth - radius <= z_near) {
+            // the box reaches behind the camera, where projecting its corners means nothing
+            bounds.x0 = bounds.y0 = 0;
+            bounds.x1 = LIGHT_GRID_X - 1;
+            bounds.y1 = LIGHT_GRID_Y - 1;
+            return true;
+        }
+
+        auto lower = glm::vec2(std::numeric_limits<float>::max());
+        auto upper = glm::vec2(std::numeric_limits<float>::lowest());
+        for (int corner = 0; corner < 8; ++corner) {
+            auto offset = glm::vec3(corner & 1 ? radius : -radius,
+                                    corner & 2 ? radius : -radius,
+                                    corner & 4 ? radius : -radius);
+            auto clip = projection_matrix * glm::vec4(center + offset, 1.0f);
+            auto ndc = glm::vec2(clip) / clip.w;
+            lower = glm::min(lower, ndc);
+            upper = glm::max(upper, ndc);
+        }
+
+        if (upper.x < -1.0f || upper.y < -1.0f || lower.x > 1.0f || lower.y > 1.0f) {
+            return false;
+        }
+
+        bounds.x0 = GetTile(lower.x, LIGHT_GRID_X);
+        bounds.x1 = GetTile(upper.x, LIGHT_GRID_X);
+        bounds.y0 = GetTile(lower.y, LIGHT_GRID_Y);
+        bounds.y1 = GetTile(upper.y, LIGHT_GRID_Y);
+        return true;
+    }
+
+    [[nodiscard]] int GetSlice(float depth) const {
+        auto slice = int(std::floor(std::log(depth) * uniforms_.depth_scale + uniforms_.depth_bias));
+        return std::clamp(slice, 0, LIGHT_GRID_Z - 1);
+    }
+
+    static int GetTile(float ndc, int n_tiles) {
+        return std::clamp(int(std::floor((ndc * 0.5f + 0.5f) * float(n_tiles))), 0, n_tiles - 1);
+    }
+
+    template <typename F> static void ForEachCluster(const ClusterBounds &bounds, F &&f) {
+        for (int z = bounds.z0; z <= bounds.z1; ++z) {
+            for (int y = bounds.y0; y <= bounds.y1; ++y) {
+                for (int x = bounds.x0; x <= bounds.x1; ++x) {
+                    f(size_t((z * LIGHT_GRID_Y + y) * LIGHT_GRID_X + x));
+                }
+            }
+        }
+    }
+
+    static void UploadBuffer(GLuint buffer, const void *data, size_t size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if (size == 0) {
+            glBufferData(GL_TEXTURE_BUFFER, kMinBufferSize, nullptr, GL_STREAM_DRAW);
+        } else {
+            glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(size), data, GL_STREAM_DRAW);
+        }
+    }
+};
+
+#endif // LIB_SHADERS_LIGHT_GRID_H_
@@ -0,0 +1,168 @@
+#ifndef LIB_SHADERS_MATERIAL_H_
+#define LIB_SHADERS_MATERIAL_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../gl_state.h"
+#include "../utils.h"
+
+#define MATERIAL_UNIFORM_BINDING 3   // binding point of the Material uniform block
+#define MATERIAL_TEXTURE_UNIT 4      // first texture unit of material textures, lower units are left to nodes and demos
+#define MATERIAL_TEXTURES_PER_ROLE 4 // sampler uniforms diffuseMap0 to diffuseMap3 etc., further textures are not bound
+#define MATERIAL_TEXTURE_ROLES 4     // diffuse, specular, normal and height
+#define MATERIAL_TEXTURE_SLOTS (MATERIAL_TEXTURE_ROLES * MATERIAL_TEXTURES_PER_ROLE)
+
+/**
+ * Sampler uniforms of the material texture slots, slot role * MATERIAL_TEXTURES_PER_ROLE + index is always bound to
+ * texture unit MATERIAL_TEXTURE_UNIT + slot.
+ */
+constexpr const char *kMaterialSamplers[MATERIAL_TEXTURE_ROLES][MATERIAL_TEXTURES_PER_ROLE] = {
+    {"diffuseMap0", "diffuseMap1", "diffuseMap2", "diffuseMap3"},
+    {"specularMap0", "specularMap1", "specularMap2", "specularMap3"},
+    {"normalMap0", "normalMap1", "normalMap2", "normalMap3"},
+    {"heightMap0", "heightMap1", "heightMap2", "heightMap3"},
+};
+
+/**
+ * std140 layout of the Material uniform block:
+ *
+ *   layout(std140) uniform Material {
+ *       vec3 meshAmbient;
+ *       vec3 meshDiffuse;
+ *       vec3 meshSpecular;
+ *       float meshShininess;
+ *   };
+ */
+struct MaterialUniforms {
+    glm::vec4 ambient{0.0f};  // w is padding
+    glm::vec4 diffuse{0.0f};  // w is padding
+    glm::vec3 specular{0.0f}; // shininess fills the rest of the vec3's 16 bytes
+    float shininess = 0;
+};
+
+static_assert(offsetof(MaterialUniforms, diffuse) == 16);
+static_assert(offsetof(MaterialUniforms, specular) == 32);
+static_assert(offsetof(MaterialUniforms, shininess) == 44);
+
+/**
+ * Material constants and textures of a mesh, laid out at load time so binding it takes one uniform buffer range and
+ * one bind of consecutive texture units.
+ */
+struct Material {
+    MaterialUniforms uniforms;
+    std::array<GLuint, MATERIAL_TEXTURE_SLOTS> textures{}; // by slot, 0 for empty slots
+    GLsizei n_texture_slots = 0;                          // slots up to the last texture, the range bound
+    uint32_t shader_features = 0;                         // SHADER_FEATURE_* flags of the texture roles present
+
+    size_t index = 0; // slice of the material buffer, set by the MaterialLibrary
+};
+
+/**
+ * Shared materials and the uniform buffer holding their constants, one aligned slice per material.
+ *
+ * Meshes with equal constants and textures share one material, the buffer is uploaded once after loading.
+ */
+class MaterialLibrary {
+public:
+    static MaterialLibrary &GetInstance() {
+        static MaterialLibrary instance;
+        return instance;
+    }
+
+    bool Initialize() {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = std::max(alignment, 1);
+        stride_ = (sizeof(MaterialUniforms) + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &buffer_);
+        dirty_ = true;
+
+        return glCheckError() == GL_NO_ERROR;
+    }
+
+    void Destroy() {
+        if (buffer_ != 0) {
+            glDeleteBuffers(1, &buffer_);
+            buffer_ = 0;
+        }
+        bound_ = nullptr;
+    }
+
+    /**
+     * @return the shared material equal to material, added if there is none yet
+     */
+    const Material *GetShared(const Material &material) {
+        std::string key((const char *)&material.uniforms, sizeof(material.uniforms));
+        key.append((const char *)material.textures.data(), sizeof(GLuint) * material.n_texture_slots);
+
+        auto &shared = materials_[key];
+        if (shared == nullptr) {
+            shared = std::make_unique<Material>(material);
+            shared->index = uniforms_.size();
+            uniforms_.push_back(material.uniforms);
+            dirty_ = true;
+        }
+
+        return shared.get();
+    }
+
+    /**
+     * Bind the constants and textures of a material, skipped if it is still bound.
+     */
+    void Bind(const Material *material) {
+        if (dirty_) {
+            Upload();
+        }
+
+        if (bound_ != material) {
+            glBindBufferRange(GL_UNIFORM_BUFFER,
+                              MATERIAL_UNIFORM_BINDING,
+                              buffer_,
+                              GLintptr(material->index * stride_),
+                              sizeof(MaterialUniforms));
+            bound_ = material;
+        }
+
+        GlStateCache::GetInstance().BindTextures2D(
+            MATERIAL_TEXTURE_UNIT, material->n_texture_slots, material->textures.data());
+    }
+
+    [[nodiscard]] size_t GetCount() const { return uniforms_.size(); }
+
+private:
+    GLuint buffer_ = 0;
+    size_t stride_ = sizeof(MaterialUniforms);
+    bool dirty_ = false;
+
+    std::unordered_map<std::string, std::unique_ptr<Material>> materials_; // by constants and textures
+    std::vector<MaterialUniforms> uniforms_;                               // by material index
+
+    const Material *bound_ = nullptr;
+
+    MaterialLibrary() = default;
+
+    void Upload() {
+        std::vector<char> data(uniforms_.size() * stride_);
+        for (size_t i = 0; i < uniforms_.size(); ++i) {
+            std::copy_n((const char *)&uniforms_[i], sizeof(MaterialUniforms), data.data() + i * stride_);
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(data.size()), data.data(), GL_STATIC_DRAW);
+
+        dirty_ = false;
+        bound_ = nullptr;
+    }
+};
+
+#endif // LIB_SHADERS_MATERIAL_H_
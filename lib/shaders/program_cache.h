@@ -0,0 +1,224 @@
+#ifndef LIB_SHADERS_PROGRAM_CACHE_H_
+#define LIB_SHADERS_PROGRAM_CACHE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "../cache_file.h"
+
+#define PROGRAM_CACHE_DIRECTORY "program_cache" // default, relative to the working directory
+#define PROGRAM_CACHE_MAGIC 0x4e494250u         // "PBIN"
+#define PROGRAM_CACHE_VERSION 1
+
+/**
+ * Programs built through the cache, and the time spent building them.
+ */
+struct ProgramCacheStats {
+    size_t hits = 0, misses = 0, rejected = 0;
+    double load_seconds = 0, compile_seconds = 0;
+    double saved_seconds = 0; // compile time recorded with each hit, minus the time loading it took
+};
+
+/**
+ * On-disk cache of linked program binaries.
+ *
+ * A program is keyed by its shader types and sources, its transform feedback varyings and the GL vendor, renderer
+ * and version, so editing a shader or updating the driver misses the cache instead of loading a stale binary. Each
+ * entry also records how long the program took to compile and link, which is what a hit saves.
+ */
+class ProgramBinaryCache {
+public:
+    static ProgramBinaryCache &GetInstance() {
+        static ProgramBinaryCache instance;
+        return instance;
+    }
+
+    void SetDirectory(const std::filesystem::path &directory) { directory_.Set(directory); }
+
+    void Disable() { enabled_ = false; }
+
+    /**
+     * @return false if disabled, or if the driver supports no program binary formats
+     */
+    bool IsEnabled() {
+        if (enabled_ && !checked_formats_) {
+            checked_formats_ = true;
+
+            GLint n_formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+            if (n_formats == 0) {
+                std::cout << "INFO: Driver supports no program binary formats, program cache disabled" << std::endl;
+                enabled_ = false;
+            }
+        }
+
+        return enabled_;
+    }
+
+    /**
+     * @param shader_sources shader types and source code
+     */
+    uint64_t GetKey(const std::vector<std::pair<std::string, GLenum>> &shader_sources,
+                    const std::vector<std::string> &feedback_varyings) const {
+        CacheKey key;
+
+        for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            auto value = (const char *)glGetString(name);
+            key.Add(value != nullptr ? value : "");
+        }
+
+        for (const auto &[code, type] : shader_sources) {
+            key.Add(&type, sizeof(type));
+            key.Add(code);
+        }
+
+        for (const auto &varying : feedback_varyings) {
+            key.Add(varying);
+        }
+
+        return key.Get();
+    }
+
+    /**
+     * Load a program binary into a new program.
+     *
+     * @return linked program, 0 if there is no entry or the driver rejects it
+     */
+    GLuint Load(uint64_t key) {
+        if (!IsEnabled()) {
+            return 0;
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+
+        auto path = directory_.GetPath(key);
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            ++stats_.misses;
+            return 0;
+        }
+
+        // the length is checked against the size of the file before allocating, a corrupt entry is rejected
+
+        std::error_code error;
+        auto size = std::filesystem::file_size(path, error);
+
+        EntryHeader header{};
+        std::vector<char> binary;
+
+        auto valid = !error && size >= sizeof(header) && file.read((char *)&header, sizeof(header)) &&
+                     header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION &&
+                     header.key == key && header.length == size - sizeof(header);
+        if (valid) {
+            binary.resize(header.length);
+            valid = bool(file.read(binary.data(), std::streamsize(binary.size())));
+        }
+
+        if (!valid) {
+            std::cerr << "WARNING: Ignoring invalid program cache entry " << path << std::endl;
+            return Reject(key);
+        }
+
+        auto program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            return Reject(key);
+        }
+
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        ++stats_.hits;
+        stats_.load_seconds += seconds;
+        stats_.saved_seconds += header.compile_seconds - seconds;
+
+        return program;
+    }
+
+    /**
+     * Ask the driver to keep the binary of a program about to be linked.
+     */
+    void Prepare(GLuint program) {
+        if (IsEnabled()) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+    }
+
+    /**
+     * Store the binary of a freshly linked program.
+     *
+     * @param compile_seconds time taken to compile and link the program
+     */
+    void Store(uint64_t key, GLuint program, double compile_seconds) {
+        stats_.compile_seconds += compile_seconds;
+
+        if (!IsEnabled()) {
+            return;
+        }
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+
+        EntryHeader header{
+            .magic = PROGRAM_CACHE_MAGIC,
+            .version = PROGRAM_CACHE_VERSION,
+            .key = key,
+            .compile_seconds = compile_seconds,
+        };
+        std::vector<char> binary(length);
+        glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+        header.length = uint32_t(binary.size());
+
+        directory_.Write(key, [&](std::ofstream &file) {
+            file.write((const char *)&header, sizeof(header));
+            file.write(binary.data(), std::streamsize(binary.size()));
+        });
+    }
+
+    [[nodiscard]] const ProgramCacheStats &GetStats() const { return stats_; }
+
+private:
+    struct EntryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        double compile_seconds;
+        GLenum format;
+        uint32_t length;
+    };
+
+    CacheDirectory directory_{PROGRAM_CACHE_DIRECTORY, "bin", "program cache"};
+    bool enabled_ = true, checked_formats_ = false;
+
+    ProgramCacheStats stats_;
+
+    ProgramBinaryCache() = default;
+
+    /**
+     * Drop an entry the driver cannot use, it is replaced once the program is compiled.
+     */
+    GLuint Reject(uint64_t key) {
+        ++stats_.rejected;
+        ++stats_.misses;
+
+        directory_.Remove(key);
+
+        return 0;
+    }
+};
+
+#endif // LIB_SHADERS_PROGRAM_CACHE_H_
@@ -1,18 +1,93 @@
 #ifndef SHADER_H_
 #define SHADER_H_
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
 #include <glad/glad.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "../gl_state.h"
 #include "../utils.h"
+#include "draw_data.h"
+#include "light_grid.h"
+#include "material.h"
+#include "program_cache.h"
+#include "shader_compiler.h"
+#include "uniform_buffer.h"
+
+/**
+ * 32-bit FNV-1a hash of a uniform name.
+ */
+constexpr uint32_t HashUniformName(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; ++name) {
+        hash = (hash ^ uint8_t(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Uniform name hashed at compile time, string literals convert to it implicitly.
+ */
+struct UniformName {
+    uint32_t hash;
+
+    consteval UniformName(const char *name) : hash(HashUniformName(name)) {} // NOLINT(google-explicit-constructor)
+};
+
+/**
+ * Typed uniform location, resolved once with ShaderProgram::GetUniform(). With permutations, a location belongs to the
+ * variant that was in use when it was resolved.
+ */
+template <typename T> struct Uniform {
+    GLint location = -1;
+};
+
+using UniformValue = std::variant<GLint, float, glm::vec2, glm::vec3, glm::mat3, glm::mat4>;
+
+// shader features compiled in or out through #defines, a program permutes on those its sources mention
+
+#define SHADER_FEATURE_DIFFUSE_MAP (1u << 0)
+#define SHADER_FEATURE_SPECULAR_MAP (1u << 1)
+#define SHADER_FEATURE_NORMAL_MAP (1u << 2)
+#define SHADER_FEATURE_HEIGHT_MAP (1u << 3)
+#define SHADER_FEATURE_DEBUG_NORMALS (1u << 4)
+#define SHADER_FEATURE_PACKED_NORMALS (1u << 5) // octahedral normal & tangent attributes, see models/vertex_format.h
 
-#define MAX_N_LIGHTS 16
+#define SHADER_LIGHT_COUNT_DEFINE "N_LIGHTS" // number of lights, also permuted on if the sources mention it
+#define SHADER_LIGHT_COUNT_SHIFT 16          // variant key bits of the light count
 
+struct ShaderFeature {
+    uint32_t flag;
+    const char *define;
+};
+
+constexpr ShaderFeature kShaderFeatures[] = {
+    {SHADER_FEATURE_DIFFUSE_MAP, "HAS_DIFFUSE_MAP"},
+    {SHADER_FEATURE_SPECULAR_MAP, "HAS_SPECULAR_MAP"},
+    {SHADER_FEATURE_NORMAL_MAP, "HAS_NORMAL_MAP"},
+    {SHADER_FEATURE_HEIGHT_MAP, "HAS_HEIGHT_MAP"},
+    {SHADER_FEATURE_DEBUG_NORMALS, "DEBUG_NORMALS"},
+    {SHADER_FEATURE_PACKED_NORMALS, "PACKED_NORMALS"},
+};
+
+/**
+ * Shader program, built from shader files, and its permutations.
+ *
+ * Sources that test the SHADER_FEATURE_* defines, or use N_LIGHTS, are compiled into one variant per combination of
+ * features and light count in use. Variants for the features of initialized meshes are compiled in the background
+ * ahead of use, others on demand. The program forwards Use() and uniform setters to the variant in use; uniform values
+ * set through the named setters are kept and applied again when the variant changes.
+ */
 class ShaderProgram {
 public:
     ShaderProgram(const char *vertexShaderPath, const char *geometryShaderPath, const char *fragmentShaderPath)
@@ -28,75 +103,378 @@ public:
               {fragmentShaderPath, GL_FRAGMENT_SHADER},
           }) {}
 
-    ShaderProgram(const std::vector<std::pair<std::string, GLenum>> &shader_sources) {
-        std::vector<GLuint> shaders;
-        if (LoadShadersFromFiles(shader_sources, shaders)) {
-            program_ = glCreateProgram();
-            if (!LinkProgramFromShaders(shaders, program_)) {
-                glDeleteProgram(program_);
-                program_ = 0;
+    ShaderProgram(const std::vector<std::pair<std::string, GLenum>> &shader_sources) { Build(shader_sources, {}); }
+
+    ~ShaderProgram() {
+        std::erase(GetPendingPrograms(), this);
+        std::erase(GetPrograms(), this);
+
+        for (auto &[key, variant] : variants_) {
+            if (variant != this) {
+                delete variant;
             }
         }
-        DestroyShaders(shaders);
     }
 
-    void ConfigureCamera(const glm::vec3 &camera_position, const glm::mat4 &projection, const glm::mat4 &view) {
-        Use();
-        glCheckError();
+    /**
+     * Wait for the variants still compiling.
+     *
+     * @return true if all variants started so far linked
+     */
+    bool IsReady() {
+        auto ready = true;
+        for (auto &[key, variant] : variants_) {
+            variant->Finish();
+            ready = ready && variant->program_ != 0;
+        }
+        return ready;
+    }
+
+    void Use() { UseVariant(mesh_features_); }
+
+    /**
+     * Use the variant for the given per-draw features, combined with the program-wide ones and the light count.
+     *
+     * @param features SHADER_FEATURE_* flags, those the program does not permute on are ignored
+     */
+    void UseVariant(uint32_t features) {
+        mesh_features_ = features;
+
+        auto variant = this;
+        if (IsPermuted()) {
+            auto key = GetVariantKey(features);
+            variant = active_->key_ == key ? active_ : GetVariant(key);
+        }
+
+        variant->Finish();
+        GlStateCache::GetInstance().UseProgram(variant->program_);
 
-        SetVec3("cameraPosition", camera_position);
-        SetMat4("projectionMatrix", projection);
-        SetMat4("viewMatrix", view);
-        glCheckError();
+        if (variant != active_) {
+            active_ = variant;
+            for (const auto &[hash, value] : values_) {
+                std::visit([&](const auto &v) { SetValue(hash, v); }, value);
+            }
+        }
     }
 
-    void ConfigureLights(GLuint n_lights,
-                         const glm::vec3 *positions,
-                         const glm::vec3 *directions,
-                         const glm::vec3 *diffuses) {
-        Use();
-        glCheckError();
+    /**
+     * Enable or disable a program-wide feature, taking effect with the next Use().
+     */
+    void SetFeature(uint32_t feature, bool enabled) {
+        features_ = enabled ? features_ | feature : features_ & ~feature;
+    }
 
-        SetInt("nLights", n_lights);
-        SetVec3Array("lightDiffuses", MAX_N_LIGHTS, diffuses);
-        SetVec3Array("lightDirections", MAX_N_LIGHTS, directions);
-        SetVec3Array("lightPositions", MAX_N_LIGHTS, positions);
-        glCheckError();
+    /**
+     * Light count compiled into the programs that permute on it, taking effect with their next Use().
+     */
+    static void SetLightCount(GLint n_lights) { light_count_ = std::clamp(n_lights, 0, MAX_N_LIGHTS); }
+
+    /**
+     * Per-draw features of the default vertex layout, the variant programs built from now on start compiling first.
+     */
+    static void SetDefaultFeatures(uint32_t features) { default_features_ = features; }
+
+    /**
+     * Start compiling, in the background, the variants of every program for per-draw features that will be drawn
+     * with, and those of programs built later. Call it when loading meshes, so their first draws do not compile.
+     *
+     * @param features SHADER_FEATURE_* flags
+     */
+    static void PrepareFeatures(uint32_t features) {
+        auto &prepared = GetPreparedFeatures();
+        if (std::find(prepared.begin(), prepared.end(), features) != prepared.end()) {
+            return;
+        }
+        prepared.push_back(features);
+
+        for (auto program : GetPrograms()) {
+            program->PrepareVariant(features);
+        }
+    }
+
+    /**
+     * Finish the programs whose background compilation has completed, without waiting for the others. Call it between
+     * loading assets, so that programs are ready before they are first used.
+     */
+    static void PollPending() {
+        auto &compiler = ShaderCompiler::GetInstance();
+        auto programs = GetPendingPrograms(); // finishing a program removes it from the list
+        for (auto program : programs) {
+            if (compiler.IsLinkComplete(program->program_)) {
+                program->Finish();
+            }
+        }
     }
 
-    [[nodiscard]] bool IsReady() const { return program_ != 0; }
+    /**
+     * @return location of an active uniform, -1 if the program has none of that name (setting it is a no-op)
+     */
+    [[nodiscard]] GLint GetUniformLocation(UniformName name) const { return active_->GetOwnUniformLocation(name.hash); }
 
-    void Use() const { glUseProgram(this->program_); }
+    template <typename T> [[nodiscard]] Uniform<T> GetUniform(UniformName name) const {
+        return Uniform<T>{.location = GetUniformLocation(name)};
+    }
 
-    void SetFloat(const char *name, float value) const { glUniform1f(glGetUniformLocation(program_, name), value); }
+    void Set(Uniform<float> uniform, float value) const { glUniform1f(uniform.location, value); }
 
-    void SetInt(const char *name, GLint value) const { glUniform1i(glGetUniformLocation(program_, name), value); }
+    void Set(Uniform<GLint> uniform, GLint value) const { glUniform1i(uniform.location, value); }
 
-    void SetMat3(const char *name, glm::mat3 mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(program_, name), 1, GL_FALSE, glm::value_ptr(mat));
+    void Set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
     }
 
-    void SetMat4(const char *name, glm::mat4 mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(program_, name), 1, GL_FALSE, glm::value_ptr(mat));
+    void Set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
     }
 
-    void SetVec2(const char *name, glm::vec2 vec) const {
-        glUniform2fv(glGetUniformLocation(program_, name), 1, glm::value_ptr(vec));
+    void Set(Uniform<glm::vec2> uniform, const glm::vec2 &vec) const {
+        glUniform2fv(uniform.location, 1, glm::value_ptr(vec));
     }
 
-    void SetVec3(const char *name, glm::vec3 vec) const {
-        glUniform3fv(glGetUniformLocation(program_, name), 1, glm::value_ptr(vec));
+    void Set(Uniform<glm::vec3> uniform, const glm::vec3 &vec) const {
+        glUniform3fv(uniform.location, 1, glm::value_ptr(vec));
     }
 
-    void SetVec3Array(const char *name, GLsizei count, const glm::vec3 *vec) const {
-        glUniform3fv(glGetUniformLocation(program_, name), count, glm::value_ptr(vec[0]));
+    void SetFloat(UniformName name, float value) { SetValue(name, value); }
+
+    void SetInt(UniformName name, GLint value) { SetValue(name, value); }
+
+    void SetMat3(UniformName name, const glm::mat3 &mat) { SetValue(name, mat); }
+
+    void SetMat4(UniformName name, const glm::mat4 &mat) { SetValue(name, mat); }
+
+    void SetVec2(UniformName name, const glm::vec2 &vec) { SetValue(name, vec); }
+
+    void SetVec3(UniformName name, const glm::vec3 &vec) { SetValue(name, vec); }
+
+    /**
+     * Not kept for other variants, set it again after each UseVariant().
+     */
+    void SetVec3Array(UniformName name, GLsizei count, const glm::vec3 *vec) const {
+        glUniform3fv(GetUniformLocation(name), count, glm::value_ptr(vec[0]));
     }
 
 protected:
     GLuint program_ = 0;
 
+    std::unordered_map<uint32_t, GLint> uniform_locations_; // by name hash, filled once the program is linked
+
+    std::vector<GLuint> pending_shaders_; // shaders of a program still compiling
+    std::chrono::steady_clock::time_point compile_begin_;
+    uint64_t cache_key_ = 0;
+
+    // permutations
+
+    std::vector<std::pair<std::string, GLenum>> codes_; // sources without defines, for building variants
+    std::vector<std::string> feedback_varyings_;
+
+    uint32_t permutations_ = 0; // SHADER_FEATURE_* flags the sources test for
+    bool permutes_light_count_ = false;
+
+    uint32_t key_ = 0, features_ = 0, mesh_features_ = 0;
+
+    std::unordered_map<uint32_t, ShaderProgram *> variants_; // by key, including this program's own
+    ShaderProgram *active_ = this;
+
+    std::unordered_map<uint32_t, UniformValue> values_; // by name hash, applied again when the variant changes
+
+    static inline GLint light_count_ = 1; // as the Lights block starts
+
+    static inline uint32_t default_features_ = SHADER_FEATURE_PACKED_NORMALS; // of the "packed" default vertex layout
+
     ShaderProgram() = default;
 
+    /**
+     * Read the shader files, find the features they permute on and start building the variant for the current state.
+     *
+     * @param shader_sources shader paths and types
+     */
+    void Build(const std::vector<std::pair<std::string, GLenum>> &shader_sources,
+               const std::vector<std::string> &feedback_varyings) {
+        if (!LoadSourcesFromFiles(shader_sources, codes_)) {
+            return;
+        }
+        feedback_varyings_ = feedback_varyings;
+
+        for (const auto &[code, type] : codes_) {
+            for (const auto &feature : kShaderFeatures) {
+                if (code.find(feature.define) != std::string::npos) {
+                    permutations_ |= feature.flag;
+                }
+            }
+            permutes_light_count_ |= code.find(SHADER_LIGHT_COUNT_DEFINE) != std::string::npos;
+        }
+
+        mesh_features_ = default_features_;
+        key_ = GetVariantKey(mesh_features_);
+        variants_[key_] = this;
+
+        Compile(GetVariantSources(key_), feedback_varyings_);
+
+        GetPrograms().push_back(this);
+        for (auto features : GetPreparedFeatures()) {
+            PrepareVariant(features);
+        }
+    }
+
+    /**
+     * Load the program from the program binary cache, or start compiling and linking it. A compiling program is
+     * finished, and added to the cache, by the first IsReady(), Use() or PollPending() that sees it done.
+     *
+     * @param codes shader sources and types
+     */
+    void Compile(const std::vector<std::pair<std::string, GLenum>> &codes,
+                 const std::vector<std::string> &feedback_varyings) {
+        auto &cache = ProgramBinaryCache::GetInstance();
+        cache_key_ = cache.GetKey(codes, feedback_varyings);
+
+        program_ = cache.Load(cache_key_);
+        if (program_ != 0) {
+            LoadUniforms();
+            return;
+        }
+
+        compile_begin_ = std::chrono::steady_clock::now();
+
+        // no status queries until the program is finished, they would wait for the compiler
+
+        for (auto &[code, type] : codes) {
+            auto shader = glCreateShader(type);
+            pending_shaders_.push_back(shader);
+
+            const char *pShaderCode = code.c_str();
+            glShaderSource(shader, 1, &pShaderCode, nullptr);
+            glCompileShader(shader);
+        }
+
+        program_ = glCreateProgram();
+        ConfigureTransformFeedbackVaryings(feedback_varyings);
+        cache.Prepare(program_);
+        for (auto shader : pending_shaders_) {
+            glAttachShader(program_, shader);
+        }
+        glLinkProgram(program_);
+
+        GetPendingPrograms().push_back(this);
+    }
+
+    /**
+     * Wait for a compiling program, then check and cache it.
+     */
+    void Finish() {
+        if (pending_shaders_.empty()) {
+            return;
+        }
+
+        std::erase(GetPendingPrograms(), this);
+
+        auto compiled = true;
+        for (auto shader : pending_shaders_) {
+            compiled = EnsureShaderCompiled(shader) && compiled;
+        }
+
+        if (compiled && EnsureProgramLinked(program_)) {
+            // includes the time spent elsewhere before the program was seen done
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - compile_begin_).count();
+            ProgramBinaryCache::GetInstance().Store(cache_key_, program_, seconds);
+            LoadUniforms();
+        } else {
+            glDeleteProgram(program_);
+            program_ = 0;
+        }
+
+        DestroyShaders(pending_shaders_);
+        pending_shaders_.clear();
+    }
+
+    [[nodiscard]] bool IsPermuted() const { return permutations_ != 0 || permutes_light_count_; }
+
+    [[nodiscard]] uint32_t GetVariantKey(uint32_t features) const {
+        auto key = (features | features_) & permutations_;
+        if (permutes_light_count_) {
+            key |= uint32_t(light_count_) << SHADER_LIGHT_COUNT_SHIFT;
+        }
+        return key;
+    }
+
+    void PrepareVariant(uint32_t features) {
+        if (IsPermuted()) {
+            GetVariant(GetVariantKey(features));
+        }
+    }
+
+    ShaderProgram *GetVariant(uint32_t key) {
+        auto &variant = variants_[key];
+        if (variant == nullptr) {
+            variant = new ShaderProgram();
+            variant->key_ = key;
+            variant->Compile(GetVariantSources(key), feedback_varyings_);
+        }
+        return variant;
+    }
+
+    /**
+     * @return sources with the defines of a variant added after their #version line
+     */
+    [[nodiscard]] std::vector<std::pair<std::string, GLenum>> GetVariantSources(uint32_t key) const {
+        if (!IsPermuted()) {
+            return codes_;
+        }
+
+        std::string defines;
+        for (const auto &feature : kShaderFeatures) {
+            if (key & feature.flag) {
+                defines += std::string("#define ") + feature.define + "\n";
+            }
+        }
+        if (permutes_light_count_) {
+            defines += std::string("#define ") + SHADER_LIGHT_COUNT_DEFINE + " " +
+                       std::to_string(key >> SHADER_LIGHT_COUNT_SHIFT) + "\n";
+        }
+
+        auto sources = codes_;
+        for (auto &[code, type] : sources) {
+            auto version = code.find("#version");
+            if (version == std::string::npos) {
+                code.insert(0, defines + "#line 1\n");
+            } else {
+                auto line_end = code.find('\n', version);
+                auto line = std::count(code.begin(), code.begin() + version, '\n') + 2;
+                code.insert(line_end == std::string::npos ? code.size() : line_end + 1,
+                            defines + "#line " + std::to_string(line) + "\n");
+            }
+        }
+        return sources;
+    }
+
+    [[nodiscard]] GLint GetOwnUniformLocation(uint32_t hash) const {
+        auto it = uniform_locations_.find(hash);
+        return it != uniform_locations_.end() ? it->second : -1;
+    }
+
+    template <typename T> void SetValue(UniformName name, const T &value) {
+        if (IsPermuted()) {
+            values_[name.hash] = value;
+        }
+        SetValue(name.hash, value);
+    }
+
+    template <typename T> void SetValue(uint32_t hash, const T &value) const {
+        Set(Uniform<T>{.location = active_->GetOwnUniformLocation(hash)}, value);
+    }
+
+    void ConfigureTransformFeedbackVaryings(const std::vector<std::string> &feedback_varyings) const {
+        if (feedback_varyings.empty()) {
+            return;
+        }
+
+        std::vector<const GLchar *> varyings;
+        for (const auto &varying : feedback_varyings) {
+            varyings.push_back(varying.c_str());
+        }
+        glTransformFeedbackVaryings(program_, GLsizei(varyings.size()), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+    }
+
     static void DestroyShaders(const std::vector<GLuint> &entries) {
         for (auto &entry : entries) {
             glDeleteShader(entry);
@@ -119,18 +497,87 @@ protected:
         return true;
     }
 
-    static bool LinkProgramFromShaders(const std::vector<GLuint> &shaders, GLuint &program) {
-        for (auto shader : shaders) {
-            glAttachShader(program, shader);
+    /**
+     * List the active uniforms of the linked program and attach its shared uniform blocks to their binding points.
+     * Arrays are listed by their name, which locates their first element, and by the name of every element.
+     */
+    void LoadUniforms() {
+        BindUniformBlock("Camera", CAMERA_UNIFORM_BINDING);
+        BindUniformBlock("Lights", LIGHTS_UNIFORM_BINDING);
+        BindUniformBlock("Draws", DRAW_DATA_UNIFORM_BINDING);
+        BindUniformBlock("Material", MATERIAL_UNIFORM_BINDING);
+        BindUniformBlock("LightGrid", LIGHT_GRID_UNIFORM_BINDING);
+
+        uniform_locations_.clear();
+
+        GLint n_uniforms = 0, max_name_length = 0;
+        glGetProgramiv(program_, GL_ACTIVE_UNIFORMS, &n_uniforms);
+        glGetProgramiv(program_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+        std::unordered_map<uint32_t, std::string> names; // for detecting hash collisions
+        auto add = [&](const std::string &name) {
+            auto location = glGetUniformLocation(program_, name.c_str());
+            if (location < 0) {
+                return; // members of uniform blocks have no location
+            }
+
+            auto hash = HashUniformName(name.c_str());
+            auto [it, inserted] = names.emplace(hash, name);
+            if (!inserted && it->second != name) {
+                std::cerr << "WARNING: Uniforms " << it->second << " and " << name << " have the same hash"
+                          << std::endl;
+            }
+
+            uniform_locations_[hash] = location;
+        };
+
+        std::vector<GLchar> buffer(std::max(max_name_length, 1));
+        for (GLint i = 0; i < n_uniforms; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program_, GLuint(i), GLsizei(buffer.size()), &length, &size, &type, buffer.data());
+
+            auto name = std::string(buffer.data(), length);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                auto base = name.substr(0, name.size() - 3);
+                add(base);
+                for (GLint element = 0; element < size; ++element) {
+                    add(base + "[" + std::to_string(element) + "]");
+                }
+            } else {
+                add(name);
+            }
+        }
+
+        // material textures and the light grid always sit on the same units, so the samplers are set once
+
+        for (GLuint role = 0; role < MATERIAL_TEXTURE_ROLES; ++role) {
+            for (GLuint i = 0; i < MATERIAL_TEXTURES_PER_ROLE; ++i) {
+                auto location = GetOwnUniformLocation(HashUniformName(kMaterialSamplers[role][i]));
+                if (location >= 0) {
+                    auto unit = MATERIAL_TEXTURE_UNIT + role * MATERIAL_TEXTURES_PER_ROLE + i;
+                    glProgramUniform1i(program_, location, GLint(unit));
+                }
+            }
         }
-        glLinkProgram(program);
 
-        return EnsureProgramLinked(program);
+        for (GLuint i = 0; i < std::size(kLightGridSamplers); ++i) {
+            auto location = GetOwnUniformLocation(HashUniformName(kLightGridSamplers[i]));
+            if (location >= 0) {
+                glProgramUniform1i(program_, location, GLint(LIGHT_GRID_TEXTURE_UNIT + i));
+            }
+        }
     }
 
-    static bool LoadShaderFromFile(const char *filePath, GLenum shaderType, GLuint &shader) {
-        std::string shaderCode;
+    void BindUniformBlock(const char *name, GLuint binding) const {
+        auto index = glGetUniformBlockIndex(program_, name);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program_, index, binding);
+        }
+    }
 
+    static bool LoadSourceFromFile(const char *filePath, std::string &shaderCode) {
         std::ifstream shaderFile;
         shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try {
@@ -147,37 +594,38 @@ protected:
             return false;
         }
 
-        const char *pShaderCode = shaderCode.c_str();
-        glShaderSource(shader, 1, &pShaderCode, nullptr);
-        return EnsureShaderCompiled(shader, shaderType);
+        return true;
     }
 
-    static bool LoadShadersFromFiles(const std::vector<std::pair<std::string, GLenum>> &shader_sources,
-                                     std::vector<GLuint> &shaders) {
+    /**
+     * @param codes source code and type of each shader, in the order of shader_sources
+     */
+    static bool LoadSourcesFromFiles(const std::vector<std::pair<std::string, GLenum>> &shader_sources,
+                                     std::vector<std::pair<std::string, GLenum>> &codes) {
         for (auto &source : shader_sources) {
             const auto &[path, type] = source;
 
-            auto shader = glCreateShader(type);
-            shaders.push_back(shader);
-
-            if (!LoadShaderFromFile(path.c_str(), type, shader)) {
+            std::string code;
+            if (!LoadSourceFromFile(path.c_str(), code)) {
                 return false;
             }
+            codes.emplace_back(std::move(code), type);
         }
 
         return true;
     }
 
 private:
-    static bool EnsureShaderCompiled(GLuint shader, GLenum shaderType) {
-        glCompileShader(shader);
-
+    static bool EnsureShaderCompiled(GLuint shader) {
         GLint success;
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         if (!success) {
             const GLsizei log_buffer_size = 1024;
             GLchar log[log_buffer_size];
 
+            GLint shaderType = 0;
+            glGetShaderiv(shader, GL_SHADER_TYPE, &shaderType);
+
             glGetShaderInfoLog(shader, log_buffer_size, nullptr, log);
             std::cout << "Error: Could not compile shader type " << shaderType << ": " << log << std::endl;
 
@@ -186,6 +634,27 @@ private:
 
         return true;
     }
+
+    static std::vector<ShaderProgram *> &GetPendingPrograms() {
+        static std::vector<ShaderProgram *> programs;
+        return programs;
+    }
+
+    /**
+     * @return built programs, without their variants
+     */
+    static std::vector<ShaderProgram *> &GetPrograms() {
+        static std::vector<ShaderProgram *> programs;
+        return programs;
+    }
+
+    /**
+     * @return per-draw features passed to PrepareFeatures()
+     */
+    static std::vector<uint32_t> &GetPreparedFeatures() {
+        static std::vector<uint32_t> features;
+        return features;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef LIB_SHADERS_SHADER_COMPILER_H_
+#define LIB_SHADERS_SHADER_COMPILER_H_
+
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "../utils.h"
+
+// KHR_parallel_shader_compile and its ARB twin share their enums, neither is part of the 4.3 glad loader
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void(APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_)(GLuint count);
+
+/**
+ * Background shader compilation, through KHR_parallel_shader_compile when the driver has it.
+ *
+ * Without the extension, drivers may still compile on their own threads, but there is no way to ask whether a
+ * program has finished without blocking on it.
+ */
+class ShaderCompiler {
+public:
+    static ShaderCompiler &GetInstance() {
+        static ShaderCompiler instance;
+        return instance;
+    }
+
+    /**
+     * @param loader for glMaxShaderCompilerThreadsKHR, which glad does not load
+     */
+    void Initialize(GLADloadproc loader) {
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_ max_threads = nullptr;
+        if (HasOpenGLExtension("GL_KHR_parallel_shader_compile")) {
+            max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_)loader("glMaxShaderCompilerThreadsKHR");
+        } else if (HasOpenGLExtension("GL_ARB_parallel_shader_compile")) {
+            max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_)loader("glMaxShaderCompilerThreadsARB");
+        }
+
+        parallel_ = max_threads != nullptr;
+        if (parallel_) {
+            max_threads(0xFFFFFFFF); // as many threads as the driver sees fit
+
+            GLint threads = 0;
+            glGetIntegerv(GL_MAX_SHADER_COMPILER_THREADS_KHR, &threads);
+            std::cout << "INFO: Compiling shaders in parallel, up to " << GLuint(threads) << " threads" << std::endl;
+        }
+    }
+
+    [[nodiscard]] bool IsParallel() const { return parallel_; }
+
+    /**
+     * Never blocks.
+     *
+     * @return true if the program has finished linking, false if it has not or it cannot be told
+     */
+    [[nodiscard]] bool IsLinkComplete(GLuint program) const {
+        if (!parallel_) {
+            return false;
+        }
+
+        GLint complete = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+private:
+    bool parallel_ = false;
+
+    ShaderCompiler() = default;
+};
+
+#endif // LIB_SHADERS_SHADER_COMPILER_H_
@@ -0,0 +1,86 @@
+#ifndef LIB_SHADERS_UNIFORM_BUFFER_H_
+#define LIB_SHADERS_UNIFORM_BUFFER_H_
+
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../utils.h"
+
+#define MAX_N_LIGHTS 16
+
+#define CAMERA_UNIFORM_BINDING 0 // binding point of the Camera uniform block
+#define LIGHTS_UNIFORM_BINDING 1 // binding point of the Lights uniform block
+
+/**
+ * std140 layout of the Camera uniform block:
+ *
+ *   layout(std140) uniform Camera {
+ *       mat4 projectionMatrix;
+ *       mat4 viewMatrix;
+ *       vec3 cameraPosition;
+ *   };
+ */
+struct CameraUniforms {
+    glm::mat4 projection_matrix{1.0f};
+    glm::mat4 view_matrix{1.0f};
+    glm::vec4 camera_position{0.0f}; // w is padding
+};
+
+static_assert(offsetof(CameraUniforms, view_matrix) == 64);
+static_assert(offsetof(CameraUniforms, camera_position) == 128);
+
+/**
+ * std140 layout of the Lights uniform block, vec3 array elements are padded to 16 bytes:
+ *
+ *   layout(std140) uniform Lights {
+ *       vec3 lightPositions[16];
+ *       vec3 lightDirections[16];
+ *       vec3 lightDiffuses[16];
+ *       int nLights;
+ *   };
+ */
+struct LightsUniforms {
+    glm::vec4 positions[MAX_N_LIGHTS]{};
+    glm::vec4 directions[MAX_N_LIGHTS]{};
+    glm::vec4 diffuses[MAX_N_LIGHTS]{};
+    GLint n_lights = 0;
+    GLint padding[3]{};
+};
+
+static_assert(offsetof(LightsUniforms, directions) == 16 * MAX_N_LIGHTS);
+static_assert(offsetof(LightsUniforms, diffuses) == 32 * MAX_N_LIGHTS);
+static_assert(offsetof(LightsUniforms, n_lights) == 48 * MAX_N_LIGHTS);
+
+/**
+ * Uniform buffer holding one T, bound to a fixed binding point shared by all shader programs.
+ */
+template <typename T> class UniformBuffer {
+public:
+    bool Initialize(GLuint binding) {
+        glGenBuffers(1, &buffer_);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer_);
+
+        return glCheckError() == GL_NO_ERROR;
+    }
+
+    void Destroy() {
+        if (buffer_ != 0) {
+            glDeleteBuffers(1, &buffer_);
+            buffer_ = 0;
+        }
+    }
+
+    void Upload(const T &data) const {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+    }
+
+private:
+    GLuint buffer_ = 0;
+};
+
+#endif // LIB_SHADERS_UNIFORM_BUFFER_H_
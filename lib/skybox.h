@@ -11,13 +11,11 @@ public:
     void Draw(ShaderProgram *shader) {
         glDisable(GL_DEPTH_TEST);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cube_map_.name);
+        GlStateCache::GetInstance().BindTexture(0, GL_TEXTURE_CUBE_MAP, cube_map_.name);
         shader->SetInt("cubeMap0", 0);
 
-        glBindVertexArray(vao_);
+        GlStateCache::GetInstance().BindVertexArray(vao_);
         glDrawArrays(GL_TRIANGLES, 0, triangle_count_);
-        glBindVertexArray(0);
 
         glEnable(GL_DEPTH_TEST);
     }
@@ -39,4 +39,16 @@ GLenum CheckOpenGLError(const char *file, int line) {
 
 #define glCheckError() CheckOpenGLError(__FILE__, __LINE__)
 
+inline bool HasOpenGLExtension(const std::string &name) {
+    GLint n_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n_extensions);
+    for (GLint i = 0; i < n_extensions; ++i) {
+        if (name == (const char *)glGetStringi(GL_EXTENSIONS, GLuint(i))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 #endif
\ No newline at end of file
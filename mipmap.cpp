@@ -78,6 +78,13 @@ private:
         current_obj_ = checkerboards_[2];
         current_shader = shaders_[0];
 
+        // the other shader finishes when first selected
+
+        if (!current_shader->IsReady()) {
+            std::cerr << "FATAL: Failed to initialize shaders" << std::endl;
+            return false;
+        }
+
         return true;
     }
 
@@ -126,9 +133,12 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char **argv) {
     auto window_title = std::string("CS7GV3: Mipmaps");
     MipMapProgram program;
+    if (!program.ParseCommandLine(argc, argv)) {
+        return 1;
+    }
     if (program.Initialize(window_title)) {
         program.Run();
         return 0;
@@ -51,6 +51,13 @@ private:
         fresnel_obj_->GetRootNode()->Scale(1.0f);
         fresnel_obj_->GetRootNode()->Translate(0.0f, -5.0f, 0.0f);
 
+        // the other shader finishes when first selected
+
+        if (!current_shader->IsReady()) {
+            std::cout << "FATAL: Failed to initialize shaders" << std::endl;
+            return false;
+        }
+
         return true;
     }
 
@@ -65,15 +72,18 @@ private:
             current_shader = shaders_[1];
         }
         if (ImGui::Checkbox("Debug: World Normal", &debug_normals_)) {
-            current_shader->SetInt("debugNormals", debug_normals_);
+            current_shader->SetFeature(SHADER_FEATURE_DEBUG_NORMALS, debug_normals_);
         }
         ImGui::End();
     }
 };
 
-int main() {
+int main(int argc, char **argv) {
     auto window_title = std::string("CS7GV3: Normal Map");
     NormalMapProgram program;
+    if (!program.ParseCommandLine(argc, argv)) {
+        return 1;
+    }
     if (program.Initialize(window_title)) {
         program.Run();
         return 0;
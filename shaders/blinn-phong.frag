@@ -12,56 +12,103 @@ in vec3 vWorldPosition;
 in vec3 vWorldNormal;
 in vec3 vWorldViewDirection;
 
-in vec3 vLightDirections[16];
 in vec3 vViewDirection;
 
-uniform vec3 cameraPosition;
-
-uniform vec3 meshAmbient;
-uniform vec3 meshDiffuse;
-uniform vec3 meshSpecular;
-uniform float meshShininess;
-
-uniform int nDiffuseMap;
-uniform int nSpecularMap;
-uniform int nNormalMap;
-uniform int nHeightMap;
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
+
+layout(std140) uniform Lights {
+    vec3 lightPositions[16];
+    vec3 lightDirections[16];
+    vec3 lightDiffuses[16];
+    int nLights;
+};
+
+layout(std140) uniform Material {
+    vec3 meshAmbient;
+    vec3 meshDiffuse;
+    vec3 meshSpecular;
+    float meshShininess;
+};
 
 uniform sampler2D diffuseMap0;
 uniform sampler2D specularMap0;
 uniform sampler2D normalMap0;
 uniform sampler2D heightMap0;
 
-uniform int nLights;
-uniform vec3 lightDiffuses[16];
-
-uniform int debugNormals;
+layout(std140) uniform LightGrid {
+    vec2 lightGridTileScale;
+    float lightGridDepthScale;
+    float lightGridDepthBias;
+    ivec3 lightGridSize;
+};
+
+uniform samplerBuffer pointLights;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+
+vec3 blinnPhong(vec3 matDiffuse, vec3 matSpecular, vec3 lightDirection, vec3 lightDiffuse) {
+    float diffuseFactor = max(dot(lightDirection, vWorldNormal), 0.0);
+    vec3 diffuse = matDiffuse * lightDiffuse * diffuseFactor;
+
+    vec3 halfwayDirection = normalize(lightDirection + vWorldViewDirection);
+    float specularFactor = pow(max(dot(halfwayDirection, vWorldNormal), 0.0), 32.0);
+    vec3 specular = matSpecular * lightDiffuse * specularFactor;
+
+    return diffuse + specular;
+}
+
+// index of the light grid cluster the fragment falls into
+int getLightCluster() {
+    float depth = -(viewMatrix * vec4(vWorldPosition, 1.0)).z;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * lightGridTileScale),
+                          int(floor(log(depth) * lightGridDepthScale + lightGridDepthBias)));
+    cluster = clamp(cluster, ivec3(0), lightGridSize - 1);
+    return (cluster.z * lightGridSize.y + cluster.y) * lightGridSize.x + cluster.x;
+}
 
 void main() {
-    vec3 result = vec3(0.0);
+    vec3 matAmbient = vec3(0.75, 0.75, 0.75);
+#ifdef HAS_DIFFUSE_MAP
+    vec3 matDiffuse = texture(diffuseMap0, vUv).xyz;
+#else
+    vec3 matDiffuse = meshDiffuse;
+#endif
+#ifdef HAS_SPECULAR_MAP
+    vec3 matSpecular = texture(specularMap0, vUv).xyz;
+#else
+    vec3 matSpecular = meshSpecular;
+#endif
 
-    for (int i = 0; i < nLights; ++i) {
-        vec3 lightDiffuse = lightDiffuses[0];
+    vec3 result = vec3(0.0);
 
-        vec3 matAmbient = vec3(0.75, 0.75, 0.75);
-        vec3 matDiffuse = nDiffuseMap > 0 ? texture(diffuseMap0, vUv).xyz : meshDiffuse;
-        vec3 matSpecular = nSpecularMap > 0 ? texture(specularMap0, vUv).xyz : meshSpecular;
+    for (int i = 0; i < N_LIGHTS; ++i) {
+        vec3 lightDirection = normalize(lightPositions[i] - vWorldPosition);
+        result += blinnPhong(matDiffuse, matSpecular, lightDirection, lightDiffuses[i]);
+    }
 
-        vec3 lightDirection = vLightDirections[0];
+    // point lights of the fragment's cluster, fading out towards their radius
 
-        float diffuseFactor = max(dot(lightDirection, vWorldNormal), 0.0);
-        vec3 diffuse = matDiffuse * lightDiffuse * diffuseFactor;
+    uvec2 cluster = texelFetch(lightClusters, getLightCluster()).xy;
+    for (uint i = cluster.x; i < cluster.x + cluster.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(i)).x);
+        vec4 lightPosition = texelFetch(pointLights, 2 * light);
+        vec3 lightColor = texelFetch(pointLights, 2 * light + 1).rgb;
 
-        vec3 halfwayDirection = normalize(lightDirection + vWorldViewDirection);
-        float specularFactor = pow(max(dot(halfwayDirection, vWorldNormal), 0.0), 32.0);
-        vec3 specular = matSpecular * lightDiffuse * specularFactor;
+        vec3 toLight = lightPosition.xyz - vWorldPosition;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - (distance * distance) / (lightPosition.w * lightPosition.w), 0.0, 1.0);
 
-        result += diffuse + specular;
+        vec3 lightDirection = toLight / max(distance, 1e-4);
+        result += falloff * falloff * blinnPhong(matDiffuse, matSpecular, lightDirection, lightColor);
     }
 
     FragColor = vec4(result, 1.0);
 
-    if (debugNormals > 0) {
-        FragColor = vec4(vNormal, 1.0);
-    }
+#ifdef DEBUG_NORMALS
+    FragColor = vec4(vNormal, 1.0);
+#endif
 }
\ No newline at end of file
@@ -12,30 +12,43 @@ in vec3 vWorldPosition;
 in vec3 vWorldNormal;
 in vec3 vWorldViewDirection;
 
-in vec3 vLightDirections[16];
 in vec3 vViewDirection;
 
-uniform vec3 cameraPosition;
-
-uniform vec3 meshAmbient;
-uniform vec3 meshDiffuse;
-uniform vec3 meshSpecular;
-uniform float meshShininess;
-
-uniform int nDiffuseMap;
-uniform int nSpecularMap;
-uniform int nNormalMap;
-uniform int nHeightMap;
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
+
+layout(std140) uniform Lights {
+    vec3 lightPositions[16];
+    vec3 lightDirections[16];
+    vec3 lightDiffuses[16];
+    int nLights;
+};
+
+layout(std140) uniform Material {
+    vec3 meshAmbient;
+    vec3 meshDiffuse;
+    vec3 meshSpecular;
+    float meshShininess;
+};
 
 uniform sampler2D diffuseMap0;
 uniform sampler2D specularMap0;
 uniform sampler2D normalMap0;
 uniform sampler2D heightMap0;
 
-uniform int nLights;
-uniform vec3 lightDiffuses[16];
+layout(std140) uniform LightGrid {
+    vec2 lightGridTileScale;
+    float lightGridDepthScale;
+    float lightGridDepthBias;
+    ivec3 lightGridSize;
+};
 
-uniform int debugNormals;
+uniform samplerBuffer pointLights;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
 
 #define F0 0.8
 #define roughness 0.1
@@ -75,19 +88,56 @@ vec3 cookTorrance(vec3 diffuse, vec3 specular, vec3 normal, vec3 lightDir, vec3
     return diffuse * lightColor * NdotL + lightColor * specular * NdotL * (k + Rs * (1.0 - k));
 }
 
-void main() {
-    vec3 lightDiffuse = lightDiffuses[0];
+// index of the light grid cluster the fragment falls into
+int getLightCluster() {
+    float depth = -(viewMatrix * vec4(vWorldPosition, 1.0)).z;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * lightGridTileScale),
+                          int(floor(log(depth) * lightGridDepthScale + lightGridDepthBias)));
+    cluster = clamp(cluster, ivec3(0), lightGridSize - 1);
+    return (cluster.z * lightGridSize.y + cluster.y) * lightGridSize.x + cluster.x;
+}
 
+void main() {
     vec3 matAmbient = vec3(0.25, 0.25, 0.25);
-    vec3 matDiffuse = nDiffuseMap > 0 ? texture(diffuseMap0, vUv).xyz : meshDiffuse;
-    vec3 matSpecular = nSpecularMap > 0 ? texture(specularMap0, vUv).xyz : meshSpecular;
+#ifdef HAS_DIFFUSE_MAP
+    vec3 matDiffuse = texture(diffuseMap0, vUv).xyz;
+#else
+    vec3 matDiffuse = meshDiffuse;
+#endif
+#ifdef HAS_SPECULAR_MAP
+    vec3 matSpecular = texture(specularMap0, vUv).xyz;
+#else
+    vec3 matSpecular = meshSpecular;
+#endif
+
+    vec3 result = vec3(0.0);
+
+    for (int i = 0; i < N_LIGHTS; ++i) {
+        vec3 lightDirection = normalize(lightPositions[i] - vWorldPosition);
+        result += cookTorrance(
+            matDiffuse, matSpecular, vWorldNormal, lightDirection, vWorldViewDirection, lightDiffuses[i]);
+    }
 
-    vec3 lightDirection = vLightDirections[0];
+    // point lights of the fragment's cluster, fading out towards their radius
 
-    vec3 result = cookTorrance(matDiffuse, matSpecular, vWorldNormal, lightDirection, vWorldViewDirection, lightDiffuse);
-    FragColor = vec4(result, 1.0);
+    uvec2 cluster = texelFetch(lightClusters, getLightCluster()).xy;
+    for (uint i = cluster.x; i < cluster.x + cluster.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(i)).x);
+        vec4 lightPosition = texelFetch(pointLights, 2 * light);
+        vec3 lightColor = texelFetch(pointLights, 2 * light + 1).rgb;
+
+        vec3 toLight = lightPosition.xyz - vWorldPosition;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - (distance * distance) / (lightPosition.w * lightPosition.w), 0.0, 1.0);
 
-    if (debugNormals > 0) {
-        FragColor = vec4(vNormal, 1.0);
+        vec3 lightDirection = toLight / max(distance, 1e-4);
+        result += falloff * falloff *
+                  cookTorrance(matDiffuse, matSpecular, vWorldNormal, lightDirection, vWorldViewDirection, lightColor);
     }
+
+    FragColor = vec4(result, 1.0);
+
+#ifdef DEBUG_NORMALS
+    FragColor = vec4(vNormal, 1.0);
+#endif
 }
\ No newline at end of file
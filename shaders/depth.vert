@@ -0,0 +1,29 @@
+#version 410 core
+
+layout(location = 0) in vec3 position;
+
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
+
+struct DrawData {
+    mat4 modelMatrix;
+    mat4 modelNormalMatrix;
+};
+
+layout(std140) uniform Draws {
+    DrawData draws[128];
+};
+
+uniform int drawIndex;
+
+// same expression as phong.vert, so the shading pass can test depth with GL_EQUAL
+invariant gl_Position;
+
+void main() {
+    mat4 modelMatrix = draws[drawIndex].modelMatrix;
+
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+}
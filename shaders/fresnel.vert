@@ -2,9 +2,25 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec2 uv;
+#ifdef PACKED_NORMALS
+layout(location = 2) in vec2 octNormal;  // octahedral, see models/vertex_format.h
+layout(location = 3) in vec4 octTangent; // octahedral, bitangent sign
+
+vec3 normal;
+vec3 tangent;
+vec3 bitangent;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+#else
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec3 tangent;
 layout(location = 4) in vec3 bitangent;
+#endif
 
 out vec3 vPosition;
 out vec2 vUv;
@@ -23,31 +39,50 @@ out vec3 vRefractDirectionR;
 out vec3 vRefractDirectionG;
 out vec3 vRefractDirectionB;
 
-uniform vec3 cameraPosition;
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
+
+struct DrawData {
+    mat4 modelMatrix;
+    mat4 modelNormalMatrix;
+};
+
+layout(std140) uniform Draws {
+    DrawData draws[128];
+};
+
+uniform int drawIndex;
 
 uniform float fresnelEtaR;
 uniform float fresnelEtaG;
 uniform float fresnelEtaB;
 
-uniform int nNormalMap;
 uniform sampler2D normalMap0;
 
 void main() {
+#ifdef PACKED_NORMALS
+    normal = decodeOctahedral(octNormal);
+    tangent = decodeOctahedral(octTangent.xy);
+    bitangent = octTangent.z * cross(normal, tangent);
+#endif
+
+    mat4 modelMatrix = draws[drawIndex].modelMatrix;
+
     vPosition = position;
     vUv = uv;
     vNormal = normal;
-    if (nNormalMap == 1) {
-        vec3 T = normalize(vec3(modelMatrix * vec4(tangent, 0.0)));
-        vec3 B = normalize(vec3(modelMatrix * vec4(bitangent, 0.0)));
-        vec3 N = normalize(vec3(modelMatrix * vec4(normal, 0.0)));
-
-        vNormal = texture(normalMap0, uv).xyz;
-        vNormal = normalize(vNormal * 2.0 - 1.0);
-        vNormal = mat3(tangent, bitangent, normal) * vNormal;
-    }
+#ifdef HAS_NORMAL_MAP
+    vec3 T = normalize(vec3(modelMatrix * vec4(tangent, 0.0)));
+    vec3 B = normalize(vec3(modelMatrix * vec4(bitangent, 0.0)));
+    vec3 N = normalize(vec3(modelMatrix * vec4(normal, 0.0)));
+
+    vNormal = texture(normalMap0, uv).xyz;
+    vNormal = normalize(vNormal * 2.0 - 1.0);
+    vNormal = mat3(tangent, bitangent, normal) * vNormal;
+#endif
 
     vWorldNormal = normalize(mat3(modelMatrix) * normal);
     vWorldPosition = mat3(modelMatrix) * position;
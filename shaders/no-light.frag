@@ -12,35 +12,37 @@ in vec3 vWorldPosition;
 in vec3 vWorldNormal;
 in vec3 vWorldViewDirection;
 
-in vec3 vLightDirections[16];
 in vec3 vViewDirection;
 
-uniform vec3 cameraPosition;
-
-uniform vec3 meshAmbient;
-uniform vec3 meshDiffuse;
-uniform vec3 meshSpecular;
-uniform float meshShininess;
-
-uniform int nDiffuseMap;
-uniform int nSpecularMap;
-uniform int nNormalMap;
-uniform int nHeightMap;
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
+
+layout(std140) uniform Lights {
+    vec3 lightPositions[16];
+    vec3 lightDirections[16];
+    vec3 lightDiffuses[16];
+    int nLights;
+};
+
+layout(std140) uniform Material {
+    vec3 meshAmbient;
+    vec3 meshDiffuse;
+    vec3 meshSpecular;
+    float meshShininess;
+};
 
 uniform sampler2D diffuseMap0;
 uniform sampler2D specularMap0;
 uniform sampler2D normalMap0;
 uniform sampler2D heightMap0;
 
-uniform int nLights;
-uniform vec3 lightDiffuses[16];
-
-uniform int debugNormals;
-
 void main() {
     FragColor = vec4(texture(diffuseMap0, vUv).xyz, 1.0);
 
-    if (debugNormals > 0) {
-        FragColor = vec4(vNormal, 1.0);
-    }
+#ifdef DEBUG_NORMALS
+    FragColor = vec4(vNormal, 1.0);
+#endif
 }
\ No newline at end of file
@@ -2,9 +2,25 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec2 uv;
+#ifdef PACKED_NORMALS
+layout(location = 2) in vec2 octNormal;  // octahedral, see models/vertex_format.h
+layout(location = 3) in vec4 octTangent; // octahedral, bitangent sign
+
+vec3 normal;
+vec3 tangent;
+vec3 bitangent;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+#else
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec3 tangent;
 layout(location = 4) in vec3 bitangent;
+#endif
 
 layout(location = 5) in vec3 deltaPosition;
 
@@ -18,42 +34,53 @@ out vec3 vWorldPosition;
 out vec3 vWorldNormal;
 out vec3 vWorldViewDirection;
 
-out vec3 vLightDirections[16];// world light direction
 out vec3 vViewDirection;
 
-uniform vec3 cameraPosition;
-uniform mat4 modelMatrix;
-uniform mat4 modelNormalMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
+
+struct DrawData {
+    mat4 modelMatrix;
+    mat4 modelNormalMatrix;
+};
 
-uniform int nLights;
-uniform vec3 lightPositions[16];
+layout(std140) uniform Draws {
+    DrawData draws[128];
+};
+
+uniform int drawIndex;
 
-uniform int nNormalMap;
 uniform sampler2D normalMap0;
 
 void main() {
+#ifdef PACKED_NORMALS
+    normal = decodeOctahedral(octNormal);
+    tangent = decodeOctahedral(octTangent.xy);
+    bitangent = octTangent.z * cross(normal, tangent);
+#endif
+
+    mat4 modelMatrix = draws[drawIndex].modelMatrix;
+    mat4 modelNormalMatrix = draws[drawIndex].modelNormalMatrix;
+
     vPosition = position - deltaPosition;
     vUv = uv;
     vNormal = normal;
-    if (nNormalMap == 1) {
-        vec3 T = normalize(vec3(modelMatrix * vec4(tangent, 0.0)));
-        vec3 B = normalize(vec3(modelMatrix * vec4(bitangent, 0.0)));
-        vec3 N = normalize(vec3(modelMatrix * vec4(normal, 0.0)));
+#ifdef HAS_NORMAL_MAP
+    vec3 T = normalize(vec3(modelMatrix * vec4(tangent, 0.0)));
+    vec3 B = normalize(vec3(modelMatrix * vec4(bitangent, 0.0)));
+    vec3 N = normalize(vec3(modelMatrix * vec4(normal, 0.0)));
 
-        vNormal = texture(normalMap0, uv).xyz;
-        vNormal = normalize(vNormal * 2.0 - 1.0);
-        vNormal = mat3(tangent, bitangent, normal) * vNormal;
-    }
+    vNormal = texture(normalMap0, uv).xyz;
+    vNormal = normalize(vNormal * 2.0 - 1.0);
+    vNormal = mat3(tangent, bitangent, normal) * vNormal;
+#endif
 
     vWorldPosition = vec3(modelMatrix * vec4(position, 1.0));
     vWorldNormal = vec3(modelNormalMatrix * vec4(normal, 0.0));
     vWorldViewDirection = normalize(cameraPosition - vWorldPosition);
 
-    for (int i = 0; i < nLights; i++) {
-        vLightDirections[i] = normalize(lightPositions[i] - vWorldPosition);
-    }
-
     gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vPosition, 1.0);
 }
@@ -4,8 +4,11 @@ layout (location = 0) in vec3 position;
 
 out vec3 vUv;
 
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
 
 void main()
 {
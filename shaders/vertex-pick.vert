@@ -4,13 +4,28 @@ layout(location = 0) in vec3 position;
 
 out float vCursorDistance;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 cameraPosition;
+};
+
+struct DrawData {
+    mat4 modelMatrix;
+    mat4 modelNormalMatrix;
+};
+
+layout(std140) uniform Draws {
+    DrawData draws[128];
+};
+
+uniform int drawIndex;
 
 uniform vec2 mousePos;
 
 void main() {
+    mat4 modelMatrix = draws[drawIndex].modelMatrix;
+
     vec4 vPosition = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
     vCursorDistance = distance(vPosition.xyz / vPosition.w, vec3(mousePos, 0.0));
     gl_Position = vPosition;
@@ -21,12 +21,8 @@ protected:
         SetLight(0, glm::vec3(0.0f, 50.0f, 50.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
         SetLightCount(1);
 
-        auto current_time = glfwGetTime();
-        auto delta_time = current_time - last_frame_time;
-        last_frame_time = current_time;
-
         if (!mouse_hold_) {
-            fresnel_obj_->Rotate(0.0f, float(delta_time) * 0.5f, 0.0f);
+            fresnel_obj_->Rotate(0.0f, float(last_frame_time_) * 0.5f, 0.0f);
         }
 
         Program::Draw();
@@ -34,8 +30,7 @@ protected:
         skybox_shader_->Use();
         skybox_->Draw(skybox_shader_);
 
-        phong_shader_->Use();
-        table_->Draw(phong_shader_);
+        DrawOpaque({{table_, phong_shader_}});
 
         fresnel_shader_->Use();
         fresnel_shader_->SetFloat("fresnelEtaR", fresnel_eta_r_);
@@ -109,8 +104,6 @@ private:
 
     float obj_center_height_ = 10.0f;
 
-    double last_frame_time = 0;
-
     bool Initialize(const std::string &window_title, bool env_map) override {
         if (!Program::Initialize(window_title, true)) {
             return false;
@@ -124,12 +117,6 @@ private:
         shaders_.push_back(phong_shader_);
         shaders_.push_back(skybox_shader_);
 
-        for (auto shader : shaders_) {
-            if (!shader->IsReady()) {
-                return false;
-            }
-        }
-
         // object
 
         if (!Scene::CreateFromFile("resources/models/crate/scene.gltf", crate_, texture_manager_)) {
@@ -174,15 +161,32 @@ private:
         skybox_ = new Skybox();
         skybox_->Initialize(50.0, skybox_maps, "resources/textures/skybox", texture_manager_);
 
-        last_frame_time = glfwGetTime();
+        for (auto shader : shaders_) {
+            if (!shader->IsReady()) {
+                return false;
+            }
+        }
+
+        // values edited through ImGui, replayed from input logs
+
+        TrackValue("fresnel_eta_r", &fresnel_eta_r_);
+        TrackValue("fresnel_eta_g", &fresnel_eta_g_);
+        TrackValue("fresnel_eta_b", &fresnel_eta_b_);
+        TrackValue("fresnel_bias", &fresnel_bias_);
+        TrackValue("fresnel_power", &fresnel_power_);
+        TrackValue("fresnel_scale", &fresnel_scale_);
+        TrackValue("obj_center_height", &obj_center_height_);
 
         return true;
     }
 };
 
-int main() {
+int main(int argc, char **argv) {
     auto window_title = std::string("CS7GV3: Transmittance");
     TransmittanceProgram program;
+    if (!program.ParseCommandLine(argc, argv)) {
+        return 1;
+    }
     if (program.Initialize(window_title)) {
         program.Run();
         return 0;
@@ -42,12 +42,6 @@ public:
         picker_shader_ = new FeedbackShaderProgram("shaders/vertex-pick.vert");
         shaders_.push_back(picker_shader_);
 
-        for (auto shader : shaders_) {
-            if (!shader->IsReady()) {
-                return false;
-            }
-        }
-
         if (!Scene::CreateFromFile("resources/models/high-res-blendshapes/neutral.obj", obj_, texture_manager_)) {
             return false;
         }
@@ -67,6 +61,12 @@ public:
         axis_->Initialize();
         axis_->Scale(0.001f);
 
+        for (auto shader : shaders_) {
+            if (!shader->IsReady()) {
+                return false;
+            }
+        }
+
         SetLight(glm::vec3(0.0f, 10.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f));
 
         camera_->SetPosition(-10.0f, 10.0f, 20.0f);
@@ -74,6 +74,14 @@ public:
 
         LoadAnimation();
 
+        // values edited through ImGui, replayed from input logs
+
+        TrackValue("enable_animation", &enable_animation_);
+        TrackValue("current_animation_frame", &current_animation_frame_);
+        for (size_t i = 0; i < delta_shapes_.size(); ++i) {
+            TrackValue("weight_" + delta_shapes_[i].first, &end_delta_weights_[i]);
+        }
+
         return true;
     }
 
@@ -110,7 +118,7 @@ private:
 
         picker_shader_->Use();
 
-        glfwGetCursorPos(window_, &mouse_x_, &mouse_y_);
+        GetCursorPos(mouse_x_, mouse_y_);
         mouse_x_ = mouse_x_ / float(window_width_) * 2.0 - 1.0;
         mouse_y_ = mouse_y_ / float(window_height_) * -2.0 + 1.0;
 
@@ -123,7 +131,7 @@ private:
 
         // register manipulator
 
-        if (glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+        if (IsMouseButtonPressed(GLFW_MOUSE_BUTTON_RIGHT)) {
             selected_vertex_ = vertex_;
         }
 
@@ -240,8 +248,11 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char **argv) {
     VertexPickProgram program;
+    if (!program.ParseCommandLine(argc, argv)) {
+        return 1;
+    }
     if (program.Initialize("CS7GV5: Vertex Pick", false)) {
         program.Run();
         return 0;